@@ -1,10 +1,16 @@
 #ifndef SANCOV_SEC_H
 #define SANCOV_SEC_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif  // __cplusplus
 
+/** v1: each section is a flat array of the records below. */
+
 struct SancovEntry {
   void *func;
   void *guard;
@@ -20,6 +26,407 @@ struct SancovFuncCall {
   void *func;
 } __attribute__((packed));
 
+/** v2: each section is a sequence of chunks, and each chunk starts with a
+ * SancovCfgHeaderV2. Guards are stored as uint32 indices relative to
+ * `guards`, the guard array of one function (or its array of 8-bit counters
+ * or bool flags, indices then count bytes), in struct-of-arrays layout:
+ *
+ *   SANCOV_CFG_EDGES,   one chunk per function:
+ *     uint32_t src[count]; uint32_t dst[count];
+ *   SANCOV_CFG_CALLS,   one chunk per function, `count` distinct callees:
+ *     void *callee[count]; uint32_t end[count]; uint32_t guard[end[count-1]];
+ *     callee[i] is called from guard[end[i-1]] .. guard[end[i]-1], with
+ *     end[-1] = 0 (CSR layout, each (guard, callee) pair appears once).
+ *   SANCOV_CFG_ENTRIES, one chunk per function in its comdat, one chunk
+ *     for all functions without a comdat, `guards` is NULL:
+ *     void *func[count]; void *guard[count];
+ *   SANCOV_CFG_BLOCKS,  one chunk per function with blocks that have no guard
+ *     of their own (pruned instrumentation), `count` blocks in layout order,
+ *     the entry block first; idom, ipdom and succ hold block numbers:
+ *     uint32_t guard[count];     guard of the block, or SANCOV_CFG_NONE;
+ *     uint32_t idom[count];      immediate dominator, SANCOV_CFG_NONE for the
+ *                                entry and unreachable blocks;
+ *     uint32_t ipdom[count];     immediate post-dominator, SANCOV_CFG_NONE for
+ *                                exits and blocks that never reach one;
+ *     uint32_t end[count];       block i jumps to succ[end[i-1] .. end[i]-1]
+ *     uint32_t call_end[count];  and calls callee[call_end[i-1] .. ]
+ *     uint32_t succ[end[count-1]];
+ *     void    *callee[call_end[count-1]];  aligned to the size of a pointer.
+ *   SANCOV_CFG_EPROF,   one chunk per function profiled with CFG_EDGE_PROF=1,
+ *     `count` edges between its `blocks` blocks (in layout order, the entry
+ *     block first) and block `blocks`, which stands for the caller: it jumps
+ *     to the entry block and every exit jumps to it.
+ *     void    *counters[1];      uint64_t edge counters of the function;
+ *     uint32_t blocks[1];
+ *     uint32_t guard[blocks];    guard of the block, or SANCOV_CFG_NONE;
+ *     uint32_t src[count]; uint32_t dst[count];
+ *     uint32_t counter[count];   counter of the edge, or SANCOV_CFG_NONE.
+ *     Edges without a counter form a spanning tree, their count is rebuilt
+ *     from the others: what enters a block leaves it.
+ *   SANCOV_CFG_PATHS,   one chunk per function profiled with CFG_PATHS=1,
+ *     `count` edges of the acyclic (Ball-Larus) graph of its collapsed
+ *     blocks, named by their guard:
+ *     void    *counters[1];      uint64_t counters of the function, one per
+ *                                path id;
+ *     uint32_t paths[1];         number of path ids;
+ *     uint32_t entry[1];         guard of the entry block;
+ *     uint32_t src[count]; uint32_t dst[count];
+ *     uint32_t inc[count];       added to the path id along the edge.
+ *     src is SANCOV_CFG_NONE on the edges that start a path after a back
+ *     edge, dst on the edges that end one, at an exit or a back edge. The
+ *     path of an id starts at the entry and takes at each step the edge with
+ *     the largest inc not above what is left of the id.
+ *   SANCOV_CFG_DIST,    one chunk per function built with CFG_TARGETS, `count`
+ *     is the length of its guard array:
+ *     uint32_t dist[count];      distance from the block of guard i to the
+ *                                nearest target, SANCOV_CFG_NONE if none.
+ *     The compiler counts the edges to a target within the function, a call
+ *     to a target function being one edge. cfgdump -d rewrites the column in
+ *     the linked program with the distances through calls (each call one
+ *     edge to the entry of the callee), so a runtime can read dist[] of the
+ *     chunk whose `guards` holds a guard as is.
+ *   SANCOV_CFG_WEIGHTS, one chunk per function built with CFG_WEIGHTS=1,
+ *     `count` edges between its collapsed blocks:
+ *     uint32_t profile[1];       1 if the weights follow a PGO profile, 0 if
+ *                                they are static estimates;
+ *     uint32_t src[count]; uint32_t dst[count];
+ *     uint32_t prob[count];      probability of taking the edge out of src,
+ *                                over SANCOV_CFG_PROB_ONE;
+ *     uint32_t freq[count];      times the edge runs per call of the
+ *                                function, 16.16 fixed point, saturated.
+ *   SANCOV_CFG_LOOPS,   one chunk per function with loops built with
+ *     CFG_LOOPS=1, `count` natural loops in preorder (a loop after the loop
+ *     that encloses it):
+ *     uint32_t header[count];    guard of the loop header;
+ *     uint32_t parent[count];    enclosing loop in the chunk, or
+ *                                SANCOV_CFG_NONE for an outermost loop;
+ *     uint32_t depth[count];     nesting depth, 1 for an outermost loop;
+ *     uint32_t end[count];       the back edges of loop i come from
+ *     uint32_t latch[end[count-1]];  latch[end[i-1] .. end[i]-1] (CSR).
+ *   SANCOV_CFG_FUNCS,   one chunk per function with guards, `guards` is its
+ *     guard array and `count` is 1:
+ *     void    *func[count];
+ *     int32_t  name[count];      offset of the NUL-terminated symbol name in
+ *                                the string table __sancov_func_names from
+ *                                the address of name[i], in every format;
+ *     uint32_t size[count];      the function owns guards[0 .. size-1];
+ *     uint32_t entry[count];     guard of the entry block, or SANCOV_CFG_NONE;
+ *     uint32_t blocks[count];    number of basic blocks.
+ *     The chunks are 40 bytes in v2 and 32 in rel, their alignment, so the
+ *     linker puts them back to back: a section of a single format is a table
+ *     of fixed-size records, function i at i * sancov_cfg_chunk_size(). The
+ *     linker lays them out in the order of the guard arrays, so the table is
+ *     sorted by `guards` and maps a guard to its function with a binary
+ *     search, without the symbol table (check the order, a linker script
+ *     may sort sections).
+ *   SANCOV_CFG_ICALLS,  one chunk per function with indirect calls or that
+ *     may be called indirectly (by the program or the C runtime), `count`
+ *     distinct (guard, signature) pairs:
+ *     uint32_t entry[1];         guard of the entry block, or SANCOV_CFG_NONE;
+ *     uint32_t type[1];          signature hash of the function;
+ *     uint32_t flags[1];         SANCOV_CFG_ADDR_TAKEN, SANCOV_CFG_ADDR_EXTERN,
+ *                                SANCOV_CFG_ADDR_INIT;
+ *     uint32_t guard[count];     block making an indirect call;
+ *     uint32_t sig[count];       signature hash of the called type.
+ *     An indirect call of signature s may reach the entry of every function
+ *     of type s whose address is taken (cfgdump -i), or that other modules
+ *     may take the address of (cfgdump -I). Signatures are hashed from the
+ *     IR types, pointers by address space only. Functions flagged
+ *     SANCOV_CFG_ADDR_TAKEN or SANCOV_CFG_ADDR_INIT may be called from code
+ *     without guards, cfgdump -u takes them as reachable.
+ *   SANCOV_CFG_RETURNS, one chunk per function with exits or invokes, `count`
+ *     blocks returning from the function:
+ *     uint32_t entry[1];         guard of the entry block, or SANCOV_CFG_NONE;
+ *     uint32_t conts[1];         number of invokes below;
+ *     uint32_t exit[count];      guard of a block ending with a return;
+ *     uint32_t call[conts];      guard of a block ending with an invoke;
+ *     uint32_t cont[conts];      guard of its normal destination.
+ *     A call returns to the block that made it, and the invoke ending block
+ *     call[i] also to cont[i] (when the two blocks have different guards).
+ *     With the calls of __sancov_func, this gives the return edges from the
+ *     exits of the callee (cfgdump -r, -R).
+ *   SANCOV_CFG_IDS,     one chunk per function built with CFG_STABLE_IDS=1,
+ *     `count` is the length of its guard array:
+ *     uint32_t func[1];          hash of the name of the function, prefixed
+ *                                with its file if it is local;
+ *     uint32_t id[count];        hash of the position of the block of guard
+ *                                i in the CFG, or SANCOV_CFG_NONE.
+ *     (func << 32) | id[i] names guard i across rebuilds, as long as the
+ *     function keeps its name and the CFG above the block keeps its shape
+ *     (cfgdump -s).
+ *
+ * Chunks are padded to a multiple of 8 bytes.
+ *
+ * rel: same layout, but every pointer, `guards` included, is an int32_t
+ * offset from its own address (0 for NULL), and chunks are padded to 4
+ * bytes. Such sections need no dynamic relocation in PIE or shared objects.
+ * Functions that may be preempted are referenced through their PLT entry,
+ * consistently in calls and entries.
+ *
+ * varint: pointers as in rel, and the guard indices of a chunk are packed in
+ * a byte stream of `size` bytes (SancovCfgHeaderVarint) of unsigned LEB128
+ * numbers. Records are sorted so that indices are small deltas:
+ *
+ *   SANCOV_CFG_EDGES,   `count` edges sorted by (src, dst):
+ *     stream: { src - previous src, zigzag(dst - src) } * count,
+ *     the previous src of the first edge is 0.
+ *   SANCOV_CFG_CALLS,   `count` distinct callees:
+ *     int32_t callee[count];
+ *     stream: { n, first guard, n-1 deltas to the previous guard } * count,
+ *     the guards of each callee in increasing order.
+ *   SANCOV_CFG_ENTRIES, `guards` is the guard array of the function:
+ *     int32_t func[count];
+ *     stream: { guard } * count.
+ *
+ * Chunks are padded to 4 bytes. Chunks of the other kinds (blocks, profiles,
+ * distances, weights, loops, functions, indirect calls, returns, ids) are
+ * never packed, they are emitted as rel chunks.
+ *
+ * A zero word between two chunks is padding inserted by the linker.
+ */
+#define SANCOV_CFG_MAGIC 0xcf91
+#define SANCOV_CFG_V2 2
+#define SANCOV_CFG_REL 3
+#define SANCOV_CFG_VARINT 4
+
+/** No guard, block, counter, distance or loop, in the unpacked chunks. */
+#define SANCOV_CFG_NONE 0xffffffffu
+
+/** Probability 1 in SANCOV_CFG_WEIGHTS chunks. */
+#define SANCOV_CFG_PROB_ONE 0x80000000u
+
+/** flags of SANCOV_CFG_ICALLS chunks: the address of the function is taken
+ * in its module, the function is visible to other modules, the function is
+ * a static constructor or destructor (called by the C runtime). */
+#define SANCOV_CFG_ADDR_TAKEN 1u
+#define SANCOV_CFG_ADDR_EXTERN 2u
+#define SANCOV_CFG_ADDR_INIT 4u
+
+enum SancovCfgKind {
+  SANCOV_CFG_EDGES = 1,
+  SANCOV_CFG_CALLS = 2,
+  SANCOV_CFG_ENTRIES = 3,
+  SANCOV_CFG_BLOCKS = 4,
+  SANCOV_CFG_EPROF = 5,
+  SANCOV_CFG_PATHS = 6,
+  SANCOV_CFG_DIST = 7,
+  SANCOV_CFG_WEIGHTS = 8,
+  SANCOV_CFG_LOOPS = 9,
+  SANCOV_CFG_FUNCS = 10,
+  SANCOV_CFG_ICALLS = 11,
+  SANCOV_CFG_RETURNS = 12,
+  SANCOV_CFG_IDS = 13,
+};
+
+/** Common prefix of v2, rel and varint chunk headers. */
+struct SancovCfgHeader {
+  uint16_t magic;    /* SANCOV_CFG_MAGIC */
+  uint8_t  version;  /* SANCOV_CFG_V2, SANCOV_CFG_REL or SANCOV_CFG_VARINT */
+  uint8_t  kind;     /* enum SancovCfgKind */
+  uint32_t count;    /* number of records */
+} __attribute__((packed));
+
+struct SancovCfgHeaderV2 {
+  struct SancovCfgHeader hdr;
+  void                  *guards;  /* guard array the indices are relative to */
+} __attribute__((packed));
+
+struct SancovCfgHeaderRel {
+  struct SancovCfgHeader hdr;
+  int32_t                guards;  /* relative to the address of this field */
+} __attribute__((packed));
+
+struct SancovCfgHeaderVarint {
+  struct SancovCfgHeader hdr;
+  int32_t                guards;  /* relative to the address of this field */
+  uint32_t               size;    /* bytes of the LEB128 stream */
+} __attribute__((packed));
+
+static inline int sancov_cfg_is_header(const struct SancovCfgHeader *hdr) {
+  return hdr->magic == SANCOV_CFG_MAGIC &&
+         (hdr->version == SANCOV_CFG_V2 || hdr->version == SANCOV_CFG_REL ||
+          hdr->version == SANCOV_CFG_VARINT) &&
+         hdr->kind >= SANCOV_CFG_EDGES && hdr->kind <= SANCOV_CFG_IDS;
+}
+
+/** Size of a pointer column element in a chunk. */
+static inline size_t sancov_cfg_ptr_size(const struct SancovCfgHeader *hdr) {
+  return hdr->version == SANCOV_CFG_V2 ? sizeof(void *) : sizeof(int32_t);
+}
+
+/** Size of the chunk header, `guards` included. */
+static inline size_t sancov_cfg_header_size(
+    const struct SancovCfgHeader *hdr) {
+  switch (hdr->version) {
+    case SANCOV_CFG_REL:
+      return sizeof(struct SancovCfgHeaderRel);
+    case SANCOV_CFG_VARINT:
+      return sizeof(struct SancovCfgHeaderVarint);
+    default:
+      return sizeof(struct SancovCfgHeaderV2);
+  }
+}
+
+/** Decode an unsigned LEB128 number at *p and advance *p. Return 0 if it runs
+ * past `end` or does not fit in 64 bits. */
+static inline int sancov_cfg_uleb128(const uint8_t **p, const uint8_t *end,
+                                     uint64_t *value) {
+  uint64_t result = 0;
+  unsigned shift = 0;
+  while (*p < end && shift < 64) {
+    const uint8_t byte = *(*p)++;
+    result |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return 1;
+    }
+    shift += 7;
+  }
+  return 0;
+}
+
+static inline int64_t sancov_cfg_unzigzag(uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/** Number of (guard, callee) pairs of a v2/rel SANCOV_CFG_CALLS chunk, `hdr`
+ * points to the chunk in memory. */
+static inline uint32_t sancov_cfg_calls_num(const struct SancovCfgHeader *hdr) {
+  const char *end = (const char *)hdr + sancov_cfg_header_size(hdr) +
+                    sancov_cfg_ptr_size(hdr) * hdr->count;
+  uint32_t    num = 0;
+  if (hdr->count) {
+    memcpy(&num, end + sizeof(uint32_t) * (hdr->count - 1), sizeof(num));
+  }
+  return num;
+}
+
+/** Last element of the CSR offsets `column` (end or call_end) of a
+ * SANCOV_CFG_BLOCKS chunk, ie. the number of successors or callees, or of
+ * end in a SANCOV_CFG_LOOPS chunk (column 3), the number of back edges. `hdr`
+ * points to the chunk in memory. */
+static inline uint32_t sancov_cfg_blocks_num(const struct SancovCfgHeader *hdr,
+                                             unsigned column) {
+  const char *end = (const char *)hdr + sancov_cfg_header_size(hdr) +
+                    column * sizeof(uint32_t) * hdr->count;
+  uint32_t    num = 0;
+  if (hdr->count) {
+    memcpy(&num, end + sizeof(uint32_t) * (hdr->count - 1), sizeof(num));
+  }
+  return num;
+}
+
+/** Offset of callee[] in a SANCOV_CFG_BLOCKS chunk. */
+static inline size_t sancov_cfg_blocks_callees(
+    const struct SancovCfgHeader *hdr) {
+  const size_t ptr = sancov_cfg_ptr_size(hdr);
+  const size_t off = sancov_cfg_header_size(hdr) +
+                     sizeof(uint32_t) * (5 * (size_t)hdr->count +
+                                         sancov_cfg_blocks_num(hdr, 3));
+  return (off + ptr - 1) & ~(ptr - 1);
+}
+
+/** Number of blocks of a SANCOV_CFG_EPROF chunk, `hdr` points to the chunk in
+ * memory. */
+static inline uint32_t sancov_cfg_eprof_blocks(
+    const struct SancovCfgHeader *hdr) {
+  uint32_t blocks;
+  memcpy(&blocks,
+         (const char *)hdr + sancov_cfg_header_size(hdr) +
+             sancov_cfg_ptr_size(hdr),
+         sizeof(blocks));
+  return blocks;
+}
+
+/** Number of invokes of a SANCOV_CFG_RETURNS chunk, `hdr` points to the chunk
+ * in memory. */
+static inline uint32_t sancov_cfg_returns_conts(
+    const struct SancovCfgHeader *hdr) {
+  uint32_t conts;
+  memcpy(&conts,
+         (const char *)hdr + sancov_cfg_header_size(hdr) + sizeof(uint32_t),
+         sizeof(conts));
+  return conts;
+}
+
+/** Name of the function of a SANCOV_CFG_FUNCS chunk, `hdr` points to the
+ * chunk in memory. */
+static inline const char *sancov_cfg_func_name(
+    const struct SancovCfgHeader *hdr) {
+  const char *field = (const char *)hdr + sancov_cfg_header_size(hdr) +
+                      sancov_cfg_ptr_size(hdr);
+  int32_t off;
+  memcpy(&off, field, sizeof(off));
+  return field + off;
+}
+
+/** Size of a chunk in bytes, header and padding included. `hdr` points to the
+ * chunk in memory, the size of SANCOV_CFG_CALLS, SANCOV_CFG_BLOCKS,
+ * SANCOV_CFG_EPROF, SANCOV_CFG_LOOPS and SANCOV_CFG_RETURNS chunks depends on
+ * their payload. */
+static inline size_t sancov_cfg_chunk_size(const struct SancovCfgHeader *hdr) {
+  const size_t ptr = sancov_cfg_ptr_size(hdr);
+  const size_t align = hdr->version == SANCOV_CFG_V2 ? 8 : 4;
+  size_t       size = sancov_cfg_header_size(hdr);
+  if (hdr->version == SANCOV_CFG_VARINT) {
+    uint32_t stream;
+    memcpy(&stream, &((const struct SancovCfgHeaderVarint *)hdr)->size,
+           sizeof(stream));
+    if (hdr->kind != SANCOV_CFG_EDGES) { size += ptr * (size_t)hdr->count; }
+    size += stream;
+    return (size + align - 1) & ~(align - 1);
+  }
+
+  switch (hdr->kind) {
+    case SANCOV_CFG_EDGES:
+      size += 2 * sizeof(uint32_t) * (size_t)hdr->count;
+      break;
+    case SANCOV_CFG_CALLS:
+      size += (ptr + sizeof(uint32_t)) * (size_t)hdr->count +
+              sizeof(uint32_t) * (size_t)sancov_cfg_calls_num(hdr);
+      break;
+    case SANCOV_CFG_ENTRIES:
+      size += 2 * ptr * (size_t)hdr->count;
+      break;
+    case SANCOV_CFG_BLOCKS:
+      size = sancov_cfg_blocks_callees(hdr) +
+             ptr * (size_t)sancov_cfg_blocks_num(hdr, 4);
+      break;
+    case SANCOV_CFG_EPROF:
+      size += ptr + sizeof(uint32_t) *
+                        (1 + (size_t)sancov_cfg_eprof_blocks(hdr) +
+                         3 * (size_t)hdr->count);
+      break;
+    case SANCOV_CFG_PATHS:
+      size += ptr + sizeof(uint32_t) * (2 + 3 * (size_t)hdr->count);
+      break;
+    case SANCOV_CFG_DIST:
+      size += sizeof(uint32_t) * (size_t)hdr->count;
+      break;
+    case SANCOV_CFG_WEIGHTS:
+      size += sizeof(uint32_t) * (1 + 4 * (size_t)hdr->count);
+      break;
+    case SANCOV_CFG_LOOPS:
+      size += sizeof(uint32_t) * (4 * (size_t)hdr->count +
+                                  (size_t)sancov_cfg_blocks_num(hdr, 3));
+      break;
+    case SANCOV_CFG_FUNCS:
+      size += (ptr + 4 * sizeof(uint32_t)) * (size_t)hdr->count;
+      break;
+    case SANCOV_CFG_ICALLS:
+      size += sizeof(uint32_t) * (3 + 2 * (size_t)hdr->count);
+      break;
+    case SANCOV_CFG_RETURNS:
+      size += sizeof(uint32_t) * (2 + (size_t)hdr->count +
+                                  2 * (size_t)sancov_cfg_returns_conts(hdr));
+      break;
+    case SANCOV_CFG_IDS:
+      size += sizeof(uint32_t) * (1 + (size_t)hdr->count);
+      break;
+  }
+  return (size + align - 1) & ~(align - 1);
+}
+
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
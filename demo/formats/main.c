@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/* loops, a switch, direct and indirect calls, so that every chunk kind of
+ * the edges, calls and entries sections holds more than one record. */
+static int square(int x) {
+    return x * x;
+}
+
+static int negate(int x) {
+    return -x;
+}
+
+static int classify(int x) {
+    switch (x % 4) {
+    case 0:
+        return square(x);
+    case 1:
+        return negate(x);
+    case 2:
+        return x / 2;
+    default:
+        return 0;
+    }
+}
+
+int sum(int n, int (*op)(int)) {
+    int total = 0;
+    for (int i = 0; i < n; i++) {
+        if (i % 3 == 0) {
+            continue;
+        }
+        total += op(i);
+    }
+    return total;
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 10;
+    int total = sum(n, classify);
+    while (n > 0) {
+        total += classify(n);
+        n -= 3;
+    }
+    printf("%d\n", total);
+    return 0;
+}
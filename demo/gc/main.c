@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+/* never called, --gc-sections drops it and its cfg records. */
+int dead(int x) {
+    if (x > 0) {
+        return x - 1;
+    }
+    return x + 1;
+}
+
+int live(int x) {
+    if (x > 0) {
+        return x * 2;
+    }
+    return -x;
+}
+
+int main(int argc, char **argv) {
+    printf("%d\n", live(argc));
+    return 0;
+}
@@ -0,0 +1,107 @@
+//===-- CfgAllPass.cpp - emit all cfg sections ----------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Emit __sancov_cfg_edges, __sancov_func, __sancov_icalls, __sancov_returns,
+// __sancov_entries (and __sancov_blocks with CFG_PRUNE=1, __sancov_dist with
+// CFG_TARGETS) from a single walk over the module, then __sancov_weights with
+// CFG_WEIGHTS=1, __sancov_loops with CFG_LOOPS=1 and __sancov_ids with
+// CFG_STABLE_IDS=1.
+// Equivalent to running cfg-edge, func-call and func-entry in a row, but the
+// guard mapping is computed only once.
+//
+// With CFG_PATHS=1 and CFG_EDGE_PROF=1, the functions are then instrumented
+// for path and edge profiling, see common/PathProfile.h and
+// common/EdgeProfile.h.
+//
+// Loaded into the linker (lld --load-pass-plugin) with -flto, the pass runs
+// once at the start of the link-time pipeline instead: the module then holds
+// the whole program, with inline functions deduplicated and the calls across
+// translation units direct, but no code is inlined across them yet.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/CoverageFilter.h"
+#include "common/EdgeProfile.h"
+#include "common/EdgeWeights.h"
+#include "common/GuardAnalysis.h"
+#include "common/LoopStructure.h"
+#include "common/Options.h"
+#include "common/PathProfile.h"
+#include "common/SectionWriter.h"
+#include "common/StableIds.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+
+namespace llvm {
+
+class CfgAllPass : public PassInfoMixin<CfgAllPass> {
+ public:
+  /** LinkTime: run over the merged module of full LTO. */
+  explicit CfgAllPass(bool LinkTime = false) : LinkTime(LinkTime) {
+  }
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+  static bool       isRequired() {
+    return true;
+  }
+
+ private:
+  bool LinkTime;
+};
+
+}  // namespace llvm
+
+using namespace llvm;
+
+PreservedAnalyses CfgAllPass::run(Module &mod, ModuleAnalysisManager &MAM) {
+  if (!LinkTime && CfgFilter::get().skips(mod)) {
+    return PreservedAnalyses::all();
+  }
+  PreservedAnalyses PA = WriteCfgSections(mod, MAM, CFG_SEC_ALL);
+  if (CfgOptions::get().weights) { PA.intersect(WriteEdgeWeights(mod, MAM)); }
+  if (CfgOptions::get().loops) { PA.intersect(WriteLoopStructure(mod, MAM)); }
+  if (CfgOptions::get().stable_ids) {
+    PA.intersect(WriteStableIds(mod, MAM));
+  }
+  // after the sections, splitting edges does not change the guard mapping.
+  // path profiling reads it, edge profiling does not.
+  if (CfgOptions::get().paths) {
+    PA.intersect(InstrumentPathProfile(mod, MAM));
+  }
+  if (CfgOptions::get().edge_prof) {
+    PA.intersect(InstrumentEdgeProfile(mod, MAM));
+  }
+  return PA;
+}
+
+extern "C" ::llvm::PassPluginLibraryInfo LLVM_ATTRIBUTE_WEAK
+llvmGetPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "cfg-all", "v0.1",
+          /* lambda to insert our pass into the pass pipeline. */
+          [](PassBuilder &PB) {
+            registerGuardAnalysis(PB);
+            PB.registerOptimizerLastEPCallback(
+                [](ModulePassManager &MPM, OptimizationLevel OL
+#if LLVM_VERSION_MAJOR >= 20
+                   ,
+                   ThinOrFullLTOPhase Phase
+#endif
+
+                ) { MPM.addPass(CfgAllPass()); });
+            // full LTO, once over the merged module: before inlining across
+            // translation units puts guards of several arrays in a function.
+            PB.registerFullLinkTimeOptimizationEarlyEPCallback(
+                [](ModulePassManager &MPM, OptimizationLevel OL) {
+                  MPM.addPass(CfgAllPass(/*LinkTime=*/true));
+                });
+          }};
+}
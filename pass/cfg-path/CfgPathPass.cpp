@@ -0,0 +1,64 @@
+//===-- CfgPathPass.cpp - Ball-Larus path profiling -----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Number the acyclic paths of each function over its collapsed blocks, count
+// them at run time and write the numbering into the __sancov_paths section.
+//
+// This is a thin wrapper over common/PathProfile; cfg-all does the same with
+// CFG_PATHS=1.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/CoverageFilter.h"
+#include "common/GuardAnalysis.h"
+#include "common/PathProfile.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+
+namespace llvm {
+
+class CfgPathPass : public PassInfoMixin<CfgPathPass> {
+ public:
+  CfgPathPass() {
+  }
+
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+  static bool       isRequired() {
+    return true;
+  }
+};
+
+}  // namespace llvm
+
+using namespace llvm;
+
+PreservedAnalyses CfgPathPass::run(Module &mod, ModuleAnalysisManager &MAM) {
+  if (CfgFilter::get().skips(mod)) { return PreservedAnalyses::all(); }
+  return InstrumentPathProfile(mod, MAM);
+}
+
+extern "C" ::llvm::PassPluginLibraryInfo LLVM_ATTRIBUTE_WEAK
+llvmGetPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "cfg-path", "v0.1",
+          /* lambda to insert our pass into the pass pipeline. */
+          [](PassBuilder &PB) {
+            registerGuardAnalysis(PB);
+            PB.registerOptimizerLastEPCallback(
+                [](ModulePassManager &MPM, OptimizationLevel OL
+#if LLVM_VERSION_MAJOR >= 20
+                   ,
+                   ThinOrFullLTOPhase Phase
+#endif
+
+                ) { MPM.addPass(CfgPathPass()); });
+          }};
+}
@@ -0,0 +1,61 @@
+//===-- CoverageFilter.cpp - code left out of the instrumentation ---------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The checks mirror ModuleSanitizerCoverage: the source file of the module
+// and the name of the function, both in the "coverage" section.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/CoverageFilter.h"
+#include "common/Options.h"
+
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <iostream>
+#include <string>
+
+using namespace llvm;
+
+static std::unique_ptr<SpecialCaseList> ReadList(const char        *var,
+                                                 const std::string &file) {
+  if (file.empty()) { return nullptr; }
+
+  std::string error;
+  auto        list =
+      SpecialCaseList::create({file}, *vfs::getRealFileSystem(), error);
+  if (!list) {
+    std::cerr << "\033[01;31m[!]\033[0;m Cannot read " << var << "=" << file
+              << ": " << error << std::endl;
+  }
+  return list;
+}
+
+const CfgFilter &CfgFilter::get() {
+  static const CfgFilter filter = [] {
+    CfgFilter f;
+    f.Allow = ReadList("CFG_ALLOWLIST", CfgOptions::get().allowlist);
+    f.Deny = ReadList("CFG_DENYLIST", CfgOptions::get().denylist);
+    f.Unreachable =
+        ReadList("CFG_UNREACHABLE", CfgOptions::get().unreachable);
+    return f;
+  }();
+  return filter;
+}
+
+bool CfgFilter::skips(const Module &M) const {
+  const std::string &src = M.getSourceFileName();
+  return (Allow && !Allow->inSection("coverage", "src", src)) ||
+         (Deny && Deny->inSection("coverage", "src", src));
+}
+
+bool CfgFilter::skips(const Function &F) const {
+  return (Allow && !Allow->inSection("coverage", "fun", F.getName())) ||
+         (Deny && Deny->inSection("coverage", "fun", F.getName())) ||
+         (Unreachable &&
+          Unreachable->inSection("coverage", "fun", F.getName()));
+}
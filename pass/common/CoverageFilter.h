@@ -0,0 +1,54 @@
+//===-- CoverageFilter.h - code left out of the instrumentation -*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// CFG_ALLOWLIST and CFG_DENYLIST name special case lists in the format of
+// -fsanitize-coverage-allowlist and -fsanitize-coverage-ignorelist, which
+// wrapper/cc passes to clang along with them. The plugins then skip the same
+// modules (`src:`) and functions (`fun:`) as sancov, so that no record
+// refers to code without guards.
+//
+// As in sancov, a module or function is kept if the allowlist (when given)
+// matches it and the denylist does not.
+//
+// CFG_UNREACHABLE names a second denylist, the functions cfgdump -u found
+// unreachable in a previous build. wrapper/cc passes both to clang.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_COVERAGE_FILTER_H
+#define CFG_COVERAGE_FILTER_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SpecialCaseList.h"
+
+#include <memory>
+
+namespace llvm {
+
+struct CfgFilter {
+  std::unique_ptr<SpecialCaseList> Allow;
+  std::unique_ptr<SpecialCaseList> Deny;
+  std::unique_ptr<SpecialCaseList> Unreachable;
+
+  /** sancov does not instrument M, by its source file. Only meaningful for
+   * a translation unit: the merged module of full LTO is named ld-temp.o,
+   * and the files it excludes were left without guards at compile time. */
+  bool skips(const Module &M) const;
+
+  /** sancov does not instrument F, by its symbol. */
+  bool skips(const Function &F) const;
+
+  /** Read from CfgOptions::allowlist, denylist and unreachable once per
+   * process. */
+  static const CfgFilter &get();
+};
+
+}  // namespace llvm
+
+#endif  // CFG_COVERAGE_FILTER_H
@@ -0,0 +1,202 @@
+//===-- EdgeProfile.cpp - spanning-tree edge profiling --------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A counter is placed at the end of the source of an edge if it has no other
+// successor, at the start of the destination if it has no other predecessor,
+// and in a new block otherwise. Edges that can take no counter (into an EH
+// pad, out of an indirectbr or callbr) are put on the tree first, and
+// critical edges next, so that the tree saves as many splits as it can.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/EdgeProfile.h"
+#include "common/GuardAnalysis.h"
+#include "common/ProfileCounters.h"
+#include "common/SectionWriter.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "edge-profile"
+
+STATISTIC(NumProfiledFunctions, "Functions profiled");
+STATISTIC(NumProfiledEdges, "Edges profiled, virtual edges included");
+STATISTIC(NumEdgeCounters, "Edge counters inserted");
+STATISTIC(NumSplitEdges, "Critical edges split for a counter");
+STATISTIC(NumUncountedEdges, "Edges off the tree that take no counter");
+
+static const char *counters_section = "__sancov_eprof_cntrs";
+static const char *ctor_name = "cfg.module_ctor_eprof";
+static const char *init_name = "__cfg_eprof_init";
+
+namespace {
+
+struct ProfEdge {
+  unsigned      src;
+  unsigned      dst;
+  uint64_t      weight;
+  EdgePlacement place;
+};
+
+}  // namespace
+
+static unsigned FindRoot(std::vector<unsigned> &parent, unsigned x) {
+  while (parent[x] != x) {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+/** Build the maximum spanning tree of F, instrument the other edges and fill
+ * prof. Return false, with F untouched, if F carries no guard or writer
+ * cannot record them. */
+static bool ProfileFunction(Function &F, FunctionAnalysisManager &FAM,
+                            SectionWriter &writer, FunctionEdgeProfile &prof) {
+  TimeTraceScope TimeScope("CfgEdgeProfile", F.getName());
+
+  std::vector<BasicBlock *>      blocks;
+  DenseMap<BasicBlock *, unsigned> number;
+  bool                           guarded = false;
+  for (auto &BB : F) {
+    number[&BB] = blocks.size();
+    blocks.push_back(&BB);
+    prof.Guards.push_back(GetSancovPcGuardArg(BB));
+    guarded |= prof.Guards.back() != nullptr;
+  }
+  if (!guarded || !writer.canIndex(prof.Guards)) { return false; }
+
+  BlockFrequencyInfo    &BFI = FAM.getResult<BlockFrequencyAnalysis>(F);
+  BranchProbabilityInfo &BPI = FAM.getResult<BranchProbabilityAnalysis>(F);
+  const unsigned         caller = blocks.size();
+
+  std::vector<ProfEdge> edges;
+  edges.push_back({caller, 0,
+                   BFI.getBlockFreq(blocks[0]).getFrequency(),
+                   PlaceEdge(nullptr, blocks[0], 0)});
+  for (unsigned i = 0; i < blocks.size(); i++) {
+    SmallPtrSet<BasicBlock *, 8> seen;
+    std::vector<BasicBlock *>    succs;
+    for (BasicBlock *succ : successors(blocks[i])) {
+      if (seen.insert(succ).second) { succs.push_back(succ); }
+    }
+
+    const BlockFrequency freq = BFI.getBlockFreq(blocks[i]);
+    if (succs.empty()) {
+      edges.push_back({i, caller, freq.getFrequency(), AT_SRC});
+      continue;
+    }
+    for (BasicBlock *succ : succs) {
+      edges.push_back({i, number.lookup(succ),
+                       (freq * BPI.getEdgeProbability(blocks[i], succ))
+                           .getFrequency(),
+                       PlaceEdge(blocks[i], succ, succs.size())});
+    }
+  }
+
+  // Kruskal: edges that cannot be counted first, then the heaviest ones,
+  // critical edges before the others at equal weight.
+  std::vector<unsigned> order(edges.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    const ProfEdge &x = edges[a], &y = edges[b];
+    if ((x.place == NOWHERE) != (y.place == NOWHERE)) {
+      return x.place == NOWHERE;
+    }
+    if (x.weight != y.weight) { return x.weight > y.weight; }
+    return x.place == SPLIT && y.place != SPLIT;
+  });
+
+  std::vector<unsigned> parent(blocks.size() + 1);
+  std::iota(parent.begin(), parent.end(), 0);
+  std::vector<bool> tree(edges.size(), false);
+  for (unsigned e : order) {
+    const unsigned a = FindRoot(parent, edges[e].src);
+    const unsigned b = FindRoot(parent, edges[e].dst);
+    if (a != b) {
+      parent[a] = b;
+      tree[e] = true;
+    }
+  }
+
+  unsigned counters = 0;
+  for (unsigned e = 0; e < edges.size(); e++) {
+    prof.Edges.push_back(std::make_pair(edges[e].src, edges[e].dst));
+    if (tree[e]) {
+      prof.Counter.push_back(~0u);
+    } else if (edges[e].place == NOWHERE) {
+      prof.Counter.push_back(~0u);
+      NumUncountedEdges++;
+    } else {
+      prof.Counter.push_back(counters++);
+    }
+  }
+  NumProfiledEdges += edges.size();
+  if (!counters) { return true; }
+
+  prof.Counters =
+      CreateProfileCounters(F, counters, counters_section, "__cfg_eprof_cntrs");
+  NumEdgeCounters += counters;
+  for (unsigned e = 0; e < edges.size(); e++) {
+    if (prof.Counter[e] == ~0u) { continue; }
+
+    BasicBlock  *src = edges[e].src == caller ? nullptr : blocks[edges[e].src];
+    BasicBlock  *dst = edges[e].dst == caller ? nullptr : blocks[edges[e].dst];
+    Instruction *before = !dst ? ExitInsertionPoint(src)
+                               : EdgeInsertionPoint(src, dst, edges[e].place);
+    if (edges[e].place == SPLIT && before) { NumSplitEdges++; }
+    if (before) {
+      IncrementProfileCounter(
+          before, prof.Counters,
+          ConstantInt::get(Type::getInt64Ty(F.getContext()), prof.Counter[e]));
+    }
+  }
+  return true;
+}
+
+PreservedAnalyses llvm::InstrumentEdgeProfile(Module                &M,
+                                              ModuleAnalysisManager &MAM) {
+  FunctionAnalysisManager &FAM =
+      MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  SectionWriter writer(M, CFG_SEC_EPROF);
+  bool          changed = false;
+
+  std::vector<Function *> funcs;
+  for (auto &F : M) {
+    if (!F.isDeclaration()) { funcs.push_back(&F); }
+  }
+  for (Function *F : funcs) {
+    FunctionEdgeProfile prof;
+    prof.Func = F;
+    if (!ProfileFunction(*F, FAM, writer, prof)) { continue; }
+
+    writer.addEdgeProfile(prof);
+    NumProfiledFunctions++;
+    if (prof.Counters) {
+      FAM.invalidate(*F, PreservedAnalyses::none());
+      changed = true;
+    }
+  }
+  writer.finalize();
+
+  if (!changed) { return PreservedAnalyses::all(); }
+  CreateProfileInitCall(M, counters_section, ctor_name, init_name);
+  return PreservedAnalyses::none();
+}
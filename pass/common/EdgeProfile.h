@@ -0,0 +1,57 @@
+//===-- EdgeProfile.h - spanning-tree edge profiling ------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Count the execution of every edge of a function with as few counters as
+// possible (Knuth, Ball and Larus): a virtual edge from the exits back to the
+// entry makes the CFG a circulation, so the count of the edges of any
+// spanning tree follows from the others. The edges of a maximum spanning tree,
+// weighted by BlockFrequencyInfo, are left alone and a 64-bit counter is
+// added to each other edge, splitting it if it is critical.
+//
+// The counters of a module live in __sancov_eprof_cntrs and are handed to
+// __cfg_eprof_init(start, stop) by a module constructor, as sancov does for
+// its inline counters (see wrapper/cfgprof.c). The edges, their counter and
+// the guard of each block go to __sancov_eprof (SANCOV_CFG_EPROF), from which
+// cfgdump -p rebuilds the count of every edge.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_EDGE_PROFILE_H
+#define CFG_EDGE_PROFILE_H
+
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+/** Edges of a function and the counter of each. Blocks are numbered in layout
+ * order before any edge is split, block Guards.size() stands for the
+ * caller. */
+struct FunctionEdgeProfile {
+  Function       *Func{nullptr};
+  GlobalVariable *Counters{nullptr};
+  /** guard of each block, nullptr if it has none of its own. */
+  std::vector<Constant *>                      Guards;
+  std::vector<std::pair<unsigned, unsigned>> Edges;
+  /** index in Counters of the counter of each edge, ~0u on the tree. */
+  std::vector<unsigned> Counter;
+};
+
+/** Instrument the functions of M that carry sancov guards and emit their
+ * __sancov_eprof chunks. */
+PreservedAnalyses InstrumentEdgeProfile(Module &M, ModuleAnalysisManager &MAM);
+
+}  // namespace llvm
+
+#endif  // CFG_EDGE_PROFILE_H
@@ -0,0 +1,114 @@
+//===-- EdgeWeights.cpp - static weights of the guard edges ---------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The frequency of an IR edge is that of its source times its probability.
+// An edge between collapsed blocks gets the frequencies of its IR edges
+// summed, its probability is relative to the instrumented block of its
+// source and its frequency to the entry block.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/EdgeWeights.h"
+#include "common/GuardAnalysis.h"
+#include "common/SectionWriter.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Support/BranchProbability.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "edge-weights"
+
+STATISTIC(NumWeightedFunctions, "Functions with edge weights");
+STATISTIC(NumProfileFunctions, "Functions weighted by a PGO profile");
+STATISTIC(NumWeightedEdges, "Edges weighted");
+
+/** Fill the weights of info.Edges. Return false if F has no edge. */
+static bool WeighFunction(const FunctionGuardInfo &info,
+                          FunctionAnalysisManager &FAM,
+                          FunctionEdgeWeights     &weights) {
+  Function &F = *info.Func;
+  if (info.Edges.empty() || info.BlockGuards.size() != F.size()) {
+    return false;
+  }
+  TimeTraceScope TimeScope("CfgEdgeWeights", F.getName());
+
+  BlockFrequencyInfo    &BFI = FAM.getResult<BlockFrequencyAnalysis>(F);
+  BranchProbabilityInfo &BPI = FAM.getResult<BranchProbabilityAnalysis>(F);
+
+  /** frequency of each edge between collapsed blocks, and of the block
+   * holding the guard of each collapsed block. Block frequencies can be
+   * small integers, their products are not rounded. */
+  DenseMap<std::pair<Constant *, Constant *>, long double> edge_freq;
+  DenseMap<Constant *, long double>                        head_freq;
+  DenseMap<BasicBlock *, Constant *>                       guard_of;
+  unsigned                                                 i = 0;
+  for (auto &BB : F) { guard_of[&BB] = info.BlockGuards[i++]; }
+
+  for (auto &BB : F) {
+    Constant *src = guard_of.lookup(&BB);
+    if (!src) { continue; }
+    const long double freq = BFI.getBlockFreq(&BB).getFrequency();
+    if (GetSancovPcGuardArg(BB) == src) { head_freq[src] = freq; }
+
+    SmallPtrSet<BasicBlock *, 8> seen;
+    for (BasicBlock *succ : successors(&BB)) {
+      Constant *dst = guard_of.lookup(succ);
+      if (!dst || dst == src || !seen.insert(succ).second) { continue; }
+      const BranchProbability prob = BPI.getEdgeProbability(&BB, succ);
+      edge_freq[std::make_pair(src, dst)] +=
+          freq * prob.getNumerator() / prob.getDenominator();
+    }
+  }
+
+  const long double one = BranchProbability::getOne().getNumerator();
+  const long double entry = std::max<uint64_t>(
+      BFI.getBlockFreq(&F.getEntryBlock()).getFrequency(), 1);
+  weights.Profile = F.hasProfileData();
+  for (const auto &edge : info.Edges) {
+    const long double freq = edge_freq.lookup(edge);
+    const long double head = head_freq.lookup(edge.first);
+    const long double prob = head > 0 ? std::min(freq / head, 1.0L) : 0;
+    const long double per_call = freq / entry * 65536;
+
+    weights.Edges.push_back(edge);
+    weights.Prob.push_back((uint32_t)(prob * one + 0.5L));
+    weights.Freq.push_back(per_call >= UINT32_MAX
+                               ? UINT32_MAX
+                               : (uint32_t)(per_call + 0.5L));
+  }
+  NumWeightedEdges += weights.Edges.size();
+  return true;
+}
+
+PreservedAnalyses llvm::WriteEdgeWeights(Module &M, ModuleAnalysisManager &MAM) {
+  const auto &result = MAM.getResult<GuardAnalysis>(M);
+  FunctionAnalysisManager &FAM =
+      MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  SectionWriter writer(M, CFG_SEC_WEIGHTS);
+
+  for (const auto &info : result.Functions) {
+    FunctionEdgeWeights weights;
+    weights.Func = info.Func;
+    if (!WeighFunction(info, FAM, weights)) { continue; }
+
+    writer.addEdgeWeights(weights);
+    NumWeightedFunctions++;
+    if (weights.Profile) { NumProfileFunctions++; }
+  }
+  writer.finalize();
+  return CfgSectionsPreserved();
+}
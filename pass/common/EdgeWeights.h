@@ -0,0 +1,51 @@
+//===-- EdgeWeights.h - static weights of the guard edges -------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Weigh the edges between collapsed blocks (see GuardAnalysis) with
+// BranchProbabilityInfo and BlockFrequencyInfo, which follow the branch
+// weights of a PGO profile when the function has one. The weight of an edge
+// sums the IR edges between the two collapsed blocks.
+//
+// The weights go to __sancov_weights (SANCOV_CFG_WEIGHTS), and cfgdump -w
+// prints them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_EDGE_WEIGHTS_H
+#define CFG_EDGE_WEIGHTS_H
+
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+/** Weights of the edges of a function, in guard space. */
+struct FunctionEdgeWeights {
+  Function *Func{nullptr};
+  /** the weights come from the branch weights of a PGO profile. */
+  bool                                           Profile{false};
+  std::vector<std::pair<Constant *, Constant *>> Edges;
+  /** probability of taking the edge out of its source, over 1u << 31. */
+  std::vector<uint32_t> Prob;
+  /** times the edge runs per call of the function, 16.16 fixed point. */
+  std::vector<uint32_t> Freq;
+};
+
+/** Emit the __sancov_weights chunks of the functions of M. Must run before
+ * the CFG is changed, the guard mapping is that of GuardAnalysis. */
+PreservedAnalyses WriteEdgeWeights(Module &M, ModuleAnalysisManager &MAM);
+
+}  // namespace llvm
+
+#endif  // CFG_EDGE_WEIGHTS_H
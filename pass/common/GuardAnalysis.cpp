@@ -0,0 +1,617 @@
+//===-- GuardAnalysis.cpp - map basic blocks to sancov guards -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Blocks without a guard (eg. inserted by address sanitizer after sancov)
+// inherit the guard of the instrumented block that reaches them, and are
+// collapsed into it.
+//
+// Blocks are numbered densely and every step is linear in the number of
+// blocks and edges, so huge generated functions (parser tables, switch-based
+// state machines) do not blow up compile time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/GuardAnalysis.h"
+#include "common/CoverageFilter.h"
+#include "common/Options.h"
+#include "common/VirtualCalls.h"
+
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "guard-analysis"
+
+STATISTIC(NumFunctions, "Functions analyzed");
+STATISTIC(NumFilteredFunctions, "Functions left out by CFG_ALLOWLIST or CFG_DENYLIST");
+STATISTIC(NumEmptyBlocks, "Blocks without a guard");
+STATISTIC(NumIndirectCalls, "Indirect calls");
+STATISTIC(NumAddressTaken, "Functions whose address is taken");
+STATISTIC(NumRuntimeCalls, "Calls to intrinsics and sancov callbacks skipped");
+STATISTIC(NumDuplicateCalls, "Calls to a callee already called by the block");
+STATISTIC(NumPrunedBlocks, "Blocks without a guard of their own");
+
+AnalysisKey GuardAnalysis::Key;
+
+/** Walk guard down to its global. Offsets are only added up if DL is set. */
+static GlobalVariable *FindGuardBase(Constant *guard, const DataLayout *DL,
+                                     uint64_t *offset) {
+  if (offset) { *offset = 0; }
+  while (true) {
+    if (auto *GV = dyn_cast<GlobalVariable>(guard)) { return GV; }
+
+    auto *CE = dyn_cast<ConstantExpr>(guard);
+    if (!CE) { return nullptr; }
+
+    switch (CE->getOpcode()) {
+      case Instruction::GetElementPtr: {
+        // getelementptr ([N x i32], @__sancov_gen_, 0, k)
+        auto *GEP = cast<GEPOperator>(CE);
+        if (DL) {
+          APInt off(DL->getIndexTypeSizeInBits(GEP->getType()), 0);
+          if (!GEP->accumulateConstantOffset(*DL, off)) { return nullptr; }
+          *offset += off.getSExtValue();
+        } else if (!GEP->hasAllConstantIndices()) {
+          return nullptr;
+        }
+        guard = cast<Constant>(GEP->getPointerOperand());
+        break;
+      }
+      case Instruction::Add: {
+        // inttoptr (add (ptrtoint @__sancov_gen_), 4k)
+        auto *off = dyn_cast<ConstantInt>(CE->getOperand(1));
+        if (!off) { return nullptr; }
+        if (offset) { *offset += off->getSExtValue(); }
+        guard = CE->getOperand(0);
+        break;
+      }
+      case Instruction::BitCast:
+      case Instruction::AddrSpaceCast:
+      case Instruction::IntToPtr:
+      case Instruction::PtrToInt:
+        guard = CE->getOperand(0);
+        break;
+      default:
+        return nullptr;
+    }
+  }
+}
+
+GlobalVariable *llvm::GetGuardBase(Constant *guard, const DataLayout &DL,
+                                   uint64_t &offset) {
+  return FindGuardBase(guard, &DL, &offset);
+}
+
+/** Element of __sancov_cntrs or __sancov_bools loaded by I, or nullptr. */
+static Constant *GetSancovInlineElement(Instruction &I) {
+  // inline-8bit-counters loads, increments and stores the counter of the
+  // block. inline-bool-flag loads the flag and stores it in a block split
+  // off the instrumented one, so only loads mark a block.
+  auto *LI = dyn_cast<LoadInst>(&I);
+  if (!LI) { return nullptr; }
+  auto *ptr = dyn_cast<Constant>(LI->getPointerOperand());
+  if (!ptr) { return nullptr; }
+
+  // look at the section before computing any offset, the struct layouts of
+  // the DataLayout are cached without a lock and this runs on the workers.
+  GlobalVariable *GV = FindGuardBase(ptr, nullptr, nullptr);
+  if (!GV || !GV->hasSection()) { return nullptr; }
+  const StringRef section = GV->getSection();
+  return section == "__sancov_cntrs" || section == "__sancov_bools" ? ptr
+                                                                    : nullptr;
+}
+
+Constant *llvm::GetSancovPcGuardArg(BasicBlock &BB) {
+  Constant *element = nullptr;
+  for (auto &I : BB) {
+    if (auto *CB = dyn_cast<CallBase>(&I)) {
+      Function *Callee = CB->getCalledFunction();
+      if (!Callee) continue;
+      const StringRef calleeName = Callee->getName();
+      if (calleeName == "__sanitizer_cov_trace_pc_guard" ||
+          calleeName == "__sanitizer_cov_trace_pc") {
+        return cast<Constant>(CB->getArgOperand(0));
+      }
+    } else if (!element) {
+      element = GetSancovInlineElement(I);
+    }
+  }
+
+  // the guard wins if several modes are combined, so that all blocks of a
+  // function index the same array. do not create a nullptr because it will
+  // be overwrite.
+  return element;
+}
+
+static void PrintSignatureType(raw_ostream &OS, Type *Ty) {
+  if (Ty->isPointerTy()) {
+    OS << "p" << Ty->getPointerAddressSpace();
+  } else if (auto *ST = dyn_cast<StructType>(Ty)) {
+    OS << (ST->isPacked() ? "<{" : "{");
+    for (Type *elem : ST->elements()) {
+      PrintSignatureType(OS, elem);
+      OS << ",";
+    }
+    OS << (ST->isPacked() ? "}>" : "}");
+  } else if (auto *AT = dyn_cast<ArrayType>(Ty)) {
+    OS << "[" << AT->getNumElements() << "x";
+    PrintSignatureType(OS, AT->getElementType());
+    OS << "]";
+  } else if (auto *VT = dyn_cast<VectorType>(Ty)) {
+    const ElementCount count = VT->getElementCount();
+    OS << "<" << (count.isScalable() ? "vscale" : "")
+       << count.getKnownMinValue() << "x";
+    PrintSignatureType(OS, VT->getElementType());
+    OS << ">";
+  } else {
+    Ty->print(OS);
+  }
+}
+
+uint32_t llvm::GetSignatureHash(FunctionType *FTy) {
+  std::string        sig;
+  raw_string_ostream OS(sig);
+  PrintSignatureType(OS, FTy->getReturnType());
+  OS << "(";
+  for (Type *param : FTy->params()) {
+    PrintSignatureType(OS, param);
+    OS << ",";
+  }
+  OS << (FTy->isVarArg() ? "...)" : ")");
+  OS.flush();
+
+  const uint64_t hash = MD5Hash(sig);
+  return (uint32_t)(hash ^ (hash >> 32));
+}
+
+/** The address of F is used other than to call it. The sancov pc table, the
+ * cfg sections and the llvm.* arrays (used, compiler.used, ctors) refer to
+ * F without letting the program call it indirectly. */
+static bool IsAddressTaken(const Function &F) {
+  SmallVector<const Use *, 8>  work;
+  SmallPtrSet<const User *, 8> seen;
+  for (const Use &U : F.uses()) { work.push_back(&U); }
+  while (!work.empty()) {
+    const Use  *U = work.pop_back_val();
+    const User *user = U->getUser();
+    if (auto *CB = dyn_cast<CallBase>(user)) {
+      if (CB->isCallee(U)) { continue; }
+      return true;
+    }
+    if (auto *GV = dyn_cast<GlobalVariable>(user)) {
+      if (isLLVMIntrinsicFn(GV->getName()) ||
+          StrRefStartsWith(GV->getSection(), "__sancov_")) {
+        continue;
+      }
+      return true;
+    }
+    if (isa<Constant>(user) && !isa<GlobalValue>(user)) {
+      // a constant expression or aggregate, follow it to its users.
+      if (seen.insert(user).second) {
+        for (const Use &UU : user->uses()) { work.push_back(&UU); }
+      }
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+static bool isSancovRuntimeFn(const StringRef &name) {
+  return name == "__sanitizer_cov_trace_pc_guard" ||
+         name == "__sanitizer_cov_trace_pc_guard_init" ||
+         name == "__sanitizer_cov_8bit_counters_init" ||
+         name == "__sanitizer_cov_bool_flag_init" ||
+         name == "__sanitizer_cov_pcs_init";
+}
+
+/** Fill info.Blocks if some block of F has no guard of its own. `own` is the
+ * guard of each block before collapsing, the callees of block i are
+ * callees[call_begin[i] .. call_begin[i+1]). The trees are built locally, the
+ * function analysis manager is not thread-safe. */
+static void AnalyzeBlocks(Function &F, const std::vector<BasicBlock *> &blocks,
+                          const DenseMap<BasicBlock *, unsigned> &number,
+                          const std::vector<unsigned>            &succ_begin,
+                          const std::vector<unsigned>            &succs,
+                          const std::vector<Constant *>          &own,
+                          const std::vector<unsigned>            &call_begin,
+                          const std::vector<Function *>          &callees,
+                          FunctionGuardInfo                      &info) {
+  const unsigned none = ~0u;
+  const unsigned nblocks = blocks.size();
+
+  /** inline-bool-flag splits each instrumented block into a head (load and
+   * test the flag), a then block (set it) and a tail (the original code).
+   * Contract them back into the head. */
+  std::vector<unsigned> rep(nblocks), then_of(nblocks, none),
+      tail_of(nblocks, none);
+  for (unsigned i = 0; i < nblocks; i++) { rep[i] = i; }
+  for (unsigned i = 0; i < nblocks; i++) {
+    auto *br = dyn_cast<BranchInst>(blocks[i]->getTerminator());
+    if (!own[i] || !br || !br->isConditional()) { continue; }
+
+    BasicBlock *then = br->getSuccessor(0), *tail = br->getSuccessor(1);
+    if (then == tail || own[number.lookup(then)] || own[number.lookup(tail)] ||
+        then->getSinglePredecessor() != blocks[i] ||
+        then->getSingleSuccessor() != tail) {
+      continue;
+    }
+    for (auto &I : *then) {
+      auto *SI = dyn_cast<StoreInst>(&I);
+      if (SI && SI->getPointerOperand() == own[i]) {
+        then_of[i] = number.lookup(then);
+        tail_of[i] = number.lookup(tail);
+        rep[then_of[i]] = rep[tail_of[i]] = i;
+        break;
+      }
+    }
+  }
+
+  std::vector<unsigned> node(nblocks, none);
+  unsigned              nodes = 0, pruned = 0;
+  for (unsigned i = 0; i < nblocks; i++) {
+    if (rep[i] != i) { continue; }
+    node[i] = nodes++;
+    if (!own[i]) { pruned++; }
+  }
+  if (!pruned) { return; }
+  NumPrunedBlocks += pruned;
+
+  DominatorTree     DT(F);
+  PostDominatorTree PDT(F);
+  auto parent = [&](DomTreeNodeBase<BasicBlock> *tree) -> unsigned {
+    if (!tree || !tree->getIDom() || !tree->getIDom()->getBlock()) {
+      return none;
+    }
+    return node[rep[number.lookup(tree->getIDom()->getBlock())]];
+  };
+
+  FunctionGuardInfo::BlockGraph &graph = info.Blocks;
+  for (unsigned i = 0; i < nblocks; i++) {
+    if (rep[i] != i) { continue; }
+
+    const unsigned members[] = {i, then_of[i], tail_of[i]};
+    const unsigned last = tail_of[i] != none ? tail_of[i] : i;
+    const size_t   first_callee = graph.Callees.size();
+    graph.Guards.push_back(own[i]);
+    graph.IDom.push_back(parent(DT.getNode(blocks[i])));
+    graph.IPDom.push_back(parent(PDT.getNode(blocks[last])));
+    for (unsigned m : members) {
+      if (m == none) { continue; }
+      for (unsigned j = succ_begin[m]; j < succ_begin[m + 1]; j++) {
+        // edges inside a split block, but not a loop back to its head.
+        if (rep[succs[j]] == i && succs[j] != i) { continue; }
+        graph.Succs.push_back(node[rep[succs[j]]]);
+      }
+      for (unsigned j = call_begin[m]; j < call_begin[m + 1]; j++) {
+        if (std::find(graph.Callees.begin() + first_callee,
+                      graph.Callees.end(),
+                      callees[j]) == graph.Callees.end()) {
+          graph.Callees.push_back(callees[j]);
+        }
+      }
+    }
+    graph.SuccEnd.push_back(graph.Succs.size());
+    graph.CallEnd.push_back(graph.Callees.size());
+  }
+}
+
+/** Candidate callees of the virtual calls of a function. */
+using VirtualCallees = DenseMap<const CallBase *, std::vector<Function *>>;
+
+static void AnalyzeFunction(Function &F, const VirtualCallees &virtual_targets,
+                            FunctionGuardInfo &info) {
+  TimeTraceScope TimeScope("CfgAnalyzeFunction", F.getName());
+  info.Func = &F;
+
+  /** Number blocks densely, and store successors in CSR form. */
+  std::vector<BasicBlock *>        blocks;
+  DenseMap<BasicBlock *, unsigned> number;
+  for (auto &block : F) {
+    number[&block] = blocks.size();
+    blocks.push_back(&block);
+  }
+
+  const unsigned          nblocks = blocks.size();
+  std::vector<unsigned>   succ_begin(nblocks + 1, 0);
+  std::vector<unsigned>   succs;
+  std::vector<Constant *> guard(nblocks, nullptr);
+  for (unsigned i = 0; i < nblocks; i++) {
+    succ_begin[i] = succs.size();
+    for (auto *Succ : successors(blocks[i])) {
+      succs.push_back(number[Succ]);
+    }
+    guard[i] = GetSancovPcGuardArg(*blocks[i]);
+  }
+  succ_begin[nblocks] = succs.size();
+
+  /** guards before collapsing, and direct callees of each block. */
+  const bool              prune = CfgOptions::get().prune;
+  std::vector<Constant *> own;
+  std::vector<unsigned>   call_begin;
+  std::vector<Function *> block_callees;
+  if (prune) { own = guard; }
+
+  /** owner[b] is the instrumented block whose guard b inherits, or b itself
+   * if b is instrumented or not reachable from any instrumented block. */
+  const unsigned        none = ~0u;
+  std::vector<unsigned> owner(nblocks, none);
+  std::vector<unsigned> stk;
+  for (unsigned i = 0; i < nblocks; i++) {
+    if (guard[i]) { owner[i] = i; }
+  }
+  for (unsigned i = 0; i < nblocks; i++) {
+    if (owner[i] == none) { continue; }
+
+    // use depth-first search to find all
+    // reachable successors of the current block
+    stk.push_back(i);
+    while (!stk.empty()) {
+      unsigned cur = stk.back();
+      stk.pop_back();
+
+      for (unsigned j = succ_begin[cur]; j < succ_begin[cur + 1]; j++) {
+        unsigned succ = succs[j];
+        if (owner[succ] == none) {
+          owner[succ] = owner[i];  // inherit the guard from the parent block
+          stk.push_back(succ);
+        }
+      }
+    }
+  }
+  for (unsigned i = 0; i < nblocks; i++) {
+    if (owner[i] == none) {
+      owner[i] = i;
+    } else {
+      guard[i] = guard[owner[i]];
+    }
+  }
+
+  /** Bucket blocks by owner (counting sort), so that the edges leaving a
+   * collapsed block are found without scanning the whole function. */
+  std::vector<unsigned> bucket_begin(nblocks + 1, 0);
+  std::vector<unsigned> bucket(nblocks);
+  for (unsigned i = 0; i < nblocks; i++) { bucket_begin[owner[i] + 1]++; }
+  for (unsigned i = 0; i < nblocks; i++) {
+    bucket_begin[i + 1] += bucket_begin[i];
+  }
+  std::vector<unsigned> fill(bucket_begin.begin(), bucket_begin.end() - 1);
+  for (unsigned i = 0; i < nblocks; i++) { bucket[fill[owner[i]]++] = i; }
+
+  /** Edges between collapsed blocks. last_dst dedups edges of one bucket. */
+  std::vector<unsigned> last_dst(nblocks, none);
+  for (unsigned root = 0; root < nblocks; root++) {
+    if (owner[root] != root || !guard[root]) { continue; }
+
+    for (unsigned k = bucket_begin[root]; k < bucket_begin[root + 1]; k++) {
+      const unsigned block = bucket[k];
+      for (unsigned j = succ_begin[block]; j < succ_begin[block + 1]; j++) {
+        const unsigned child = owner[succs[j]];
+        if (child != root && guard[child] && last_dst[child] != root) {
+          last_dst[child] = root;
+          info.Edges.push_back(std::make_pair(guard[root], guard[child]));
+        }
+      }
+    }
+  }
+
+  /** Calls, addressed by the guard of the calling block. A callee (or the
+   * signature of an indirect call) called several times from one block (or
+   * from blocks collapsed into it) is recorded once. */
+  DenseSet<std::pair<Constant *, Function *>> seen_calls;
+  DenseSet<std::pair<unsigned, Function *>>   seen_block_calls;
+  DenseSet<std::pair<Constant *, uint32_t>>   seen_indirect;
+  unsigned indirect = 0, runtime = 0, duplicate = 0;
+
+  /** Virtual calls are calls to each of their candidate targets. */
+  auto add_call = [&](unsigned i, Function *Callee) {
+    if (prune && seen_block_calls.insert(std::make_pair(i, Callee)).second) {
+      block_callees.push_back(Callee);
+    }
+    if (seen_calls.insert(std::make_pair(guard[i], Callee)).second) {
+      info.Calls.push_back(std::make_pair(guard[i], Callee));
+    } else {
+      duplicate++;
+    }
+  };
+  for (unsigned i = 0; i < nblocks; i++) {
+    if (prune) { call_begin.push_back(block_callees.size()); }
+    if (!guard[i]) {
+      info.EmptyBlocks++;
+      continue;
+    }
+    for (auto &I : *blocks[i]) {
+      if (auto *CB = dyn_cast<CallBase>(&I)) {
+        Function *Callee = CB->getCalledFunction();
+        if (!Callee) {
+          if (!CB->isIndirectCall()) { continue; }
+          auto it = virtual_targets.find(CB);
+          if (it != virtual_targets.end()) {
+            for (Function *target : it->second) { add_call(i, target); }
+            continue;
+          }
+          const auto call = std::make_pair(
+              guard[i], GetSignatureHash(CB->getFunctionType()));
+          if (seen_indirect.insert(call).second) {
+            info.IndirectCalls.push_back(call);
+            indirect++;
+          } else {
+            duplicate++;
+          }
+          continue;
+        }
+
+        const StringRef name = Callee->getName();
+        if (isLLVMIntrinsicFn(name) || isSancovRuntimeFn(name)) {
+          // Skip LLVM intrinsic functions and sancov callbacks.
+          runtime++;
+          continue;
+        }
+        add_call(i, Callee);
+      }
+    }
+  }
+
+  /** Exits, and the blocks the invokes return to. */
+  DenseSet<Constant *>                        seen_exits;
+  DenseSet<std::pair<Constant *, Constant *>> seen_conts;
+  for (unsigned i = 0; i < nblocks; i++) {
+    const Instruction *term = blocks[i]->getTerminator();
+    if (!guard[i] || !term) { continue; }
+    if (isa<ReturnInst>(term)) {
+      if (seen_exits.insert(guard[i]).second) {
+        info.Exits.push_back(guard[i]);
+      }
+    } else if (auto *II = dyn_cast<InvokeInst>(term)) {
+      const auto cont =
+          std::make_pair(guard[i], guard[number.lookup(II->getNormalDest())]);
+      if (cont.second && cont.second != cont.first &&
+          seen_conts.insert(cont).second) {
+        info.Continuations.push_back(cont);
+      }
+    }
+  }
+
+  // the entry block is numbered first.
+  info.EntryGuard = nblocks ? guard[0] : nullptr;
+  info.BlockGuards = guard;
+  info.Signature = GetSignatureHash(F.getFunctionType());
+  info.AddressTaken = IsAddressTaken(F);
+  info.External = !F.hasLocalLinkage();
+  if (info.AddressTaken) { NumAddressTaken++; }
+
+  if (prune) {
+    call_begin.push_back(block_callees.size());
+    AnalyzeBlocks(F, blocks, number, succ_begin, succs, own, call_begin,
+                  block_callees, info);
+  }
+
+  // statistics are atomic, add them once per function.
+  NumIndirectCalls += indirect;
+  NumRuntimeCalls += runtime;
+  NumDuplicateCalls += duplicate;
+}
+
+/** Functions of the llvm.global_ctors and llvm.global_dtors arrays. */
+static void CollectInitFunctions(const Module                      &M,
+                                 SmallPtrSetImpl<const Function *> &init) {
+  for (const char *name : {"llvm.global_ctors", "llvm.global_dtors"}) {
+    const GlobalVariable *GV = M.getNamedGlobal(name);
+    if (!GV || !GV->hasInitializer()) { continue; }
+    const auto *array = dyn_cast<ConstantArray>(GV->getInitializer());
+    if (!array) { continue; }
+    for (const Use &elem : array->operands()) {
+      const auto *entry = dyn_cast<ConstantStruct>(elem.get());
+      if (!entry || entry->getNumOperands() < 2) { continue; }
+      if (const auto *F = dyn_cast<Function>(
+              entry->getOperand(1)->stripPointerCasts())) {
+        init.insert(F);
+      }
+    }
+  }
+}
+
+GuardAnalysis::Result GuardAnalysis::run(Module &M, ModuleAnalysisManager &MAM) {
+  // functions left out by CFG_ALLOWLIST, CFG_DENYLIST or CFG_UNREACHABLE
+  // have no guard, the passes skip whole modules themselves.
+  const CfgFilter        &filter = CfgFilter::get();
+  std::vector<Function *> funcs;
+  for (auto &func : M) {
+    if (func.isDeclaration() || isLLVMIntrinsicFn(func.getName())) {
+      // Skip LLVM intrinsic functions and declarations.
+      continue;
+    }
+    if (filter.skips(func)) {
+      NumFilteredFunctions++;
+      continue;
+    }
+    funcs.push_back(&func);
+  }
+
+  TimeTraceScope TimeScope("CfgGuardAnalysis", M.getName());
+  Result         result;
+  result.Functions.resize(funcs.size());
+
+  // vtable slots are found through the DataLayout, resolve them before
+  // going parallel.
+  const VirtualTargets        virt(M);
+  std::vector<VirtualCallees> virtual_targets(funcs.size());
+  for (size_t i = 0; i < funcs.size(); i++) {
+    virt.resolve(*funcs[i], virtual_targets[i]);
+  }
+
+  // the time profiler only records the calling thread, stay on it so that
+  // -ftime-trace breaks the analysis down per function.
+  const unsigned threads = CfgOptions::get().threads;
+  if (threads == 1 || funcs.size() < 2 || timeTraceProfilerEnabled()) {
+    for (size_t i = 0; i < funcs.size(); i++) {
+      AnalyzeFunction(*funcs[i], virtual_targets[i], result.Functions[i]);
+    }
+  } else {
+    // one task per worker, pulling functions in module order.
+#if LLVM_VERSION_MAJOR >= 19
+    DefaultThreadPool   pool(hardware_concurrency(threads));
+#else
+    ThreadPool          pool(hardware_concurrency(threads));
+#endif
+    std::atomic<size_t> next{0};
+    const unsigned      workers =
+        std::min<size_t>(pool.getThreadCount(), funcs.size());
+    for (unsigned w = 0; w < workers; w++) {
+      pool.async([&] {
+        for (size_t i = next++; i < funcs.size(); i = next++) {
+          AnalyzeFunction(*funcs[i], virtual_targets[i], result.Functions[i]);
+        }
+      });
+    }
+    pool.wait();
+  }
+
+  SmallPtrSet<const Function *, 8> init;
+  CollectInitFunctions(M, init);
+
+  NumFunctions += funcs.size();
+  for (auto &info : result.Functions) {
+    info.Init = init.count(info.Func);
+    NumEmptyBlocks += info.EmptyBlocks;
+  }
+
+  return result;
+}
+
+void llvm::registerGuardAnalysis(PassBuilder &PB) {
+  PB.registerAnalysisRegistrationCallback([](ModuleAnalysisManager &MAM) {
+    MAM.registerPass([] { return GuardAnalysis(); });
+  });
+}
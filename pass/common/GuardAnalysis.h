@@ -0,0 +1,145 @@
+//===-- GuardAnalysis.h - map basic blocks to sancov guards -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Address each basic block by its argument to __sanitizer_cov_trace_pc_guard
+// (or its element of the inline counters or flags), and summarize every
+// function in guard space: intra-function edges, direct calls, the
+// signatures of indirect calls, the entry guard and the exits.
+//
+// This is a module analysis, so a pipeline that emits several CFG sections
+// (see cfg-all) computes the mapping only once.
+//
+// Functions are analyzed concurrently (see CfgOptions::threads): the analysis
+// only reads the IR, and results are kept in module order so that the
+// sections do not depend on scheduling.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_GUARD_ANALYSIS_H
+#define CFG_GUARD_ANALYSIS_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+static inline bool StrRefStartsWith(const StringRef &str, const char *prefix) {
+  const size_t len = strlen(prefix);
+  if (str.size() < len) return false;
+
+  for (size_t i = 0; i < len; i++) {
+    if (str[i] != prefix[i]) return false;
+  }
+
+  return true;
+}
+
+static inline bool isLLVMIntrinsicFn(const StringRef &str) {
+  return StrRefStartsWith(str, "llvm.");
+}
+
+/** Return the guard passed to __sanitizer_cov_trace_pc_guard in BB, or with
+ * inline-8bit-counters and inline-bool-flag the element of __sancov_cntrs or
+ * __sancov_bools loaded by BB. nullptr if BB is not instrumented. */
+Constant *GetSancovPcGuardArg(BasicBlock &BB);
+
+/** Split a guard (counter, flag) into the guard array (eg. __sancov_gen_) it
+ * points into and a byte offset. Return nullptr if guard is not a constant offset from a
+ * global variable. */
+GlobalVariable *GetGuardBase(Constant *guard, const DataLayout &DL,
+                             uint64_t &offset);
+
+/** Hash of a function type as an indirect call sees it. Pointers only keep
+ * their address space, so that typed and opaque pointers, and struct types
+ * renamed when modules are linked, hash the same. */
+uint32_t GetSignatureHash(FunctionType *FTy);
+
+/** Guard-space summary of a function. */
+struct FunctionGuardInfo {
+  Function *Func{nullptr};
+  /** guard of the entry block, nullptr if it has none. */
+  Constant *EntryGuard{nullptr};
+  /** (src, dst) guards of intra-function edges. */
+  std::vector<std::pair<Constant *, Constant *>> Edges;
+  /** distinct (guard of the calling block, callee) of direct calls, and of
+   * virtual calls with each of their candidate targets (see VirtualCalls). */
+  std::vector<std::pair<Constant *, Function *>> Calls;
+  /** distinct (guard of the calling block, signature hash) of the other
+   * indirect calls. */
+  std::vector<std::pair<Constant *, uint32_t>> IndirectCalls;
+  /** signature hash of the function itself. */
+  uint32_t Signature{0};
+  /** the address of the function is used other than to call it, outside of
+   * the sancov and cfg sections. */
+  bool AddressTaken{false};
+  /** the function is visible to other modules, which may take its address. */
+  bool External{false};
+  /** the function runs before main or at exit, from llvm.global_ctors or
+   * llvm.global_dtors. */
+  bool Init{false};
+  /** distinct guards of the blocks that return from the function. */
+  std::vector<Constant *> Exits;
+  /** distinct (guard of a block ending with an invoke, guard of its normal
+   * destination) where the two differ. The other calls return to the block
+   * that made them. */
+  std::vector<std::pair<Constant *, Constant *>> Continuations;
+  /** blocks reached by no instrumented block. */
+  unsigned EmptyBlocks{0};
+  /** guard of each block after collapsing, in layout order, nullptr for the
+   * blocks reached by no instrumented block. */
+  std::vector<Constant *> BlockGuards;
+
+  /** Block-level CFG, only filled with CfgOptions::prune for functions with
+   * blocks that have no guard of their own. Blocks are numbered in layout
+   * order, ~0u stands for no block. */
+  struct BlockGraph {
+    /** guard of each block before collapsing, nullptr if pruned. */
+    std::vector<Constant *> Guards;
+    std::vector<unsigned>   IDom;
+    std::vector<unsigned>   IPDom;
+    /** successors of block i are Succs[SuccEnd[i-1] .. SuccEnd[i]), its
+     * distinct direct callees Callees[CallEnd[i-1] .. CallEnd[i]). */
+    std::vector<unsigned>   SuccEnd;
+    std::vector<unsigned>   Succs;
+    std::vector<unsigned>   CallEnd;
+    std::vector<Function *> Callees;
+  } Blocks;
+};
+
+class GuardAnalysis : public AnalysisInfoMixin<GuardAnalysis> {
+ public:
+  struct Result {
+    /** one entry per defined function, in module order. */
+    std::vector<FunctionGuardInfo> Functions;
+  };
+
+  Result run(Module &M, ModuleAnalysisManager &MAM);
+
+ private:
+  friend AnalysisInfoMixin<GuardAnalysis>;
+  static AnalysisKey Key;
+};
+
+/** Make GuardAnalysis available to the module passes of a plugin. */
+void registerGuardAnalysis(PassBuilder &PB);
+
+}  // namespace llvm
+
+#endif  // CFG_GUARD_ANALYSIS_H
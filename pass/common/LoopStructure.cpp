@@ -0,0 +1,92 @@
+//===-- LoopStructure.cpp - loops of a function in guard space ------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/LoopStructure.h"
+#include "common/GuardAnalysis.h"
+#include "common/SectionWriter.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "loop-structure"
+
+STATISTIC(NumLoops, "Loops emitted");
+STATISTIC(NumBackEdges, "Back edges emitted, in guard space");
+
+/** Fill loops with the loops of info.Func. Return false if it has none. */
+static bool FindLoops(const FunctionGuardInfo &info,
+                      FunctionAnalysisManager &FAM, FunctionLoops &loops) {
+  Function &F = *info.Func;
+  if (info.BlockGuards.size() != F.size()) { return false; }
+
+  LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+  if (LI.empty()) { return false; }
+  TimeTraceScope TimeScope("CfgLoopStructure", F.getName());
+
+  DenseMap<BasicBlock *, Constant *> guard_of;
+  unsigned                           i = 0;
+  for (auto &BB : F) { guard_of[&BB] = info.BlockGuards[i++]; }
+
+  const unsigned                   none = ~0u;
+  DenseMap<const Loop *, unsigned> index;
+  for (Loop *L : LI.getLoopsInPreorder()) {
+    Constant *header = guard_of.lookup(L->getHeader());
+    if (!header) { continue; }
+
+    // the nearest enclosing loop that was kept.
+    unsigned parent = none;
+    for (Loop *P = L->getParentLoop(); P && parent == none;
+         P = P->getParentLoop()) {
+      auto it = index.find(P);
+      if (it != index.end()) { parent = it->second; }
+    }
+
+    const size_t first = loops.Latches.size();
+    for (BasicBlock *pred : predecessors(L->getHeader())) {
+      Constant *latch = guard_of.lookup(pred);
+      if (!latch || !L->contains(pred) ||
+          std::find(loops.Latches.begin() + first, loops.Latches.end(),
+                    latch) != loops.Latches.end()) {
+        continue;
+      }
+      loops.Latches.push_back(latch);
+    }
+
+    index[L] = loops.Headers.size();
+    loops.Headers.push_back(header);
+    loops.Parent.push_back(parent);
+    loops.Depth.push_back(L->getLoopDepth());
+    loops.LatchEnd.push_back(loops.Latches.size());
+  }
+  NumLoops += loops.Headers.size();
+  NumBackEdges += loops.Latches.size();
+  return !loops.Headers.empty();
+}
+
+PreservedAnalyses llvm::WriteLoopStructure(Module                &M,
+                                           ModuleAnalysisManager &MAM) {
+  const auto &result = MAM.getResult<GuardAnalysis>(M);
+  FunctionAnalysisManager &FAM =
+      MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  SectionWriter writer(M, CFG_SEC_LOOPS);
+
+  for (const auto &info : result.Functions) {
+    FunctionLoops loops;
+    loops.Func = info.Func;
+    if (FindLoops(info, FAM, loops)) { writer.addLoops(loops); }
+  }
+  writer.finalize();
+  return CfgSectionsPreserved();
+}
@@ -0,0 +1,51 @@
+//===-- LoopStructure.h - loops of a function in guard space ----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Export LoopInfo in guard space: the guard of the header of each natural
+// loop, the guards of the sources of its back edges and its nesting, so that
+// consumers of the CFG need not search the SCCs of the whole program.
+//
+// Blocks take the guard of their collapsed block (see GuardAnalysis), so a
+// back edge inside one collapsed block has the header as its source. The
+// loops go to __sancov_loops (SANCOV_CFG_LOOPS), and cfgdump -l prints them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_LOOP_STRUCTURE_H
+#define CFG_LOOP_STRUCTURE_H
+
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+
+#include <vector>
+
+namespace llvm {
+
+/** Loops of a function in preorder, so a loop comes after its parent. */
+struct FunctionLoops {
+  Function *Func{nullptr};
+  std::vector<Constant *> Headers;
+  /** index of the enclosing loop, ~0u for the outermost loops. */
+  std::vector<unsigned> Parent;
+  /** 1 for the outermost loops. */
+  std::vector<unsigned> Depth;
+  /** sources of the back edges of loop i are Latches[LatchEnd[i-1] ..
+   * LatchEnd[i]). */
+  std::vector<unsigned>   LatchEnd;
+  std::vector<Constant *> Latches;
+};
+
+/** Emit the __sancov_loops chunks of the functions of M. Must run before
+ * the CFG is changed, the guard mapping is that of GuardAnalysis. */
+PreservedAnalyses WriteLoopStructure(Module &M, ModuleAnalysisManager &MAM);
+
+}  // namespace llvm
+
+#endif  // CFG_LOOP_STRUCTURE_H
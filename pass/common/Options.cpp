@@ -0,0 +1,123 @@
+//===-- Options.cpp - options of the cfg plugins --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/Options.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace llvm;
+
+static void ParseFormat(const char *value, CfgOptions &opts) {
+  if (strcmp(value, "v1") == 0) {
+    opts.format = 1;
+  } else if (strcmp(value, "v2") == 0) {
+    opts.format = 2;
+  } else if (strcmp(value, "rel") == 0) {
+    opts.format = 3;
+  } else if (strcmp(value, "varint") == 0) {
+    opts.format = 4;
+  } else {
+    std::cerr << "\033[01;31m[!]\033[0;m Unknown CFG_FORMAT=" << value
+              << ", use v1" << std::endl;
+  }
+}
+
+static CfgOptions ParseOptions(void) {
+  CfgOptions  opts;
+  const char *value;
+
+  if ((value = getenv("CFG_FORMAT")) != nullptr) { ParseFormat(value, opts); }
+
+  if ((value = getenv("CFG_NOALLOC")) != nullptr) {
+    opts.noalloc = strcmp(value, "1") == 0;
+  }
+  if (opts.noalloc && opts.format < 3) {
+    // the loader never relocates a section it does not map.
+    if (getenv("CFG_FORMAT")) {
+      std::cerr << "\033[01;31m[!]\033[0;m CFG_NOALLOC=1 needs "
+                   "relocation-free sections, use CFG_FORMAT=rel"
+                << std::endl;
+    }
+    opts.format = 3;
+  }
+
+  if ((value = getenv("CFG_PRUNE")) != nullptr) {
+    opts.prune = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_EDGE_PROF")) != nullptr) {
+    opts.edge_prof = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_PATHS")) != nullptr) {
+    opts.paths = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_WEIGHTS")) != nullptr) {
+    opts.weights = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_LOOPS")) != nullptr) {
+    opts.loops = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_STABLE_IDS")) != nullptr) {
+    opts.stable_ids = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_FUNCS")) != nullptr) {
+    opts.funcs = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_ICALLS")) != nullptr) {
+    opts.icalls = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_RETURNS")) != nullptr) {
+    opts.returns = strcmp(value, "1") == 0;
+  }
+
+  if ((value = getenv("CFG_PATH_MAX")) != nullptr) {
+    char *end;
+    opts.path_max = strtoul(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || opts.path_max == 0) {
+      std::cerr << "\033[01;31m[!]\033[0;m Invalid CFG_PATH_MAX=" << value
+                << ", use 4096" << std::endl;
+      opts.path_max = 4096;
+    }
+  }
+
+  if ((value = getenv("CFG_TARGETS")) != nullptr) { opts.targets = value; }
+
+  if ((value = getenv("CFG_ALLOWLIST")) != nullptr) { opts.allowlist = value; }
+
+  if ((value = getenv("CFG_DENYLIST")) != nullptr) { opts.denylist = value; }
+
+  if ((value = getenv("CFG_UNREACHABLE")) != nullptr) {
+    opts.unreachable = value;
+  }
+
+  if ((value = getenv("CFG_THREADS")) != nullptr) {
+    char *end;
+    opts.threads = strtoul(value, &end, 10);
+    if (*value == '\0' || *end != '\0') {
+      std::cerr << "\033[01;31m[!]\033[0;m Invalid CFG_THREADS=" << value
+                << ", use the calling thread" << std::endl;
+      opts.threads = 1;
+    }
+  }
+
+  return opts;
+}
+
+const CfgOptions &CfgOptions::get() {
+  static const CfgOptions opts = ParseOptions();
+  return opts;
+}
@@ -0,0 +1,103 @@
+//===-- Options.h - options of the cfg plugins ------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Options are read from the environment rather than cl::opt: pass plugins are
+// loaded after -mllvm is parsed by older clang, and several plugins sharing
+// this code may be loaded into one process. wrapper/cc forwards its
+// environment to clang, so `CFG_FORMAT=v2 cc ...` reaches the plugins.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_OPTIONS_H
+#define CFG_OPTIONS_H
+
+#include <string>
+
+namespace llvm {
+
+struct CfgOptions {
+  /** CFG_FORMAT=v1|v2|rel|varint, layout of the sections, see
+   * api/sancov_sec.h. Holds the version byte of the chunk header (rel is 3,
+   * varint 4). */
+  unsigned format{1};
+
+  /** CFG_NOALLOC=1, the sections are linked as non-allocated sections (see
+   * wrapper/cfg-noalloc.ld). Implies a relocation-free format, rel unless
+   * varint is asked for. */
+  bool noalloc{false};
+
+  /** CFG_THREADS=N, threads analyzing the functions of a module, 1 (the
+   * default) to stay on the calling thread and 0 for one per core. Builds
+   * already run one compiler per core under make -j. */
+  unsigned threads{1};
+
+  /** CFG_PRUNE=1, the program is built with pruned sancov instrumentation
+   * (without no-prune): emit the block-level CFG and dominators of functions
+   * with pruned blocks in __sancov_blocks. */
+  bool prune{false};
+
+  /** CFG_EDGE_PROF=1, count the edges off a maximum spanning tree of each
+   * function and emit the tables to rebuild the others in __sancov_eprof,
+   * see common/EdgeProfile.h. */
+  bool edge_prof{false};
+
+  /** CFG_PATHS=1, count the acyclic paths of each function by Ball-Larus
+   * path id and emit their numbering in __sancov_paths, see
+   * common/PathProfile.h. */
+  bool paths{false};
+
+  /** CFG_PATH_MAX=N, functions with more path ids are not path profiled,
+   * each id takes an 8-byte counter. */
+  unsigned path_max{4096};
+
+  /** CFG_WEIGHTS=1, emit the branch probability and frequency of every edge
+   * in __sancov_weights, see common/EdgeWeights.h. */
+  bool weights{false};
+
+  /** CFG_LOOPS=1, emit the header, back edges and nesting of every natural
+   * loop in __sancov_loops, see common/LoopStructure.h. */
+  bool loops{false};
+
+  /** CFG_STABLE_IDS=1, emit an id for every guard that survives rebuilds in
+   * __sancov_ids, see common/StableIds.h. */
+  bool stable_ids{false};
+
+  /** CFG_FUNCS=1, emit the guard range, entry guard, block count and name of
+   * every function in __sancov_funcs and __sancov_func_names. */
+  bool funcs{false};
+
+  /** CFG_ICALLS=1, emit the signature hash of every indirect call and of
+   * every function whose address is taken in __sancov_icalls. */
+  bool icalls{false};
+
+  /** CFG_RETURNS=1, emit the exits of every function and the continuations
+   * of its invokes in __sancov_returns. */
+  bool returns{false};
+
+  /** CFG_TARGETS=file, list of targets for directed fuzzing: emit the
+   * distance of every guard to the nearest target in __sancov_dist, see
+   * common/TargetDistance.h. Empty if not set. */
+  std::string targets;
+
+  /** CFG_ALLOWLIST=file and CFG_DENYLIST=file, special case lists of the
+   * modules and functions sancov instruments, see common/CoverageFilter.h.
+   * Empty if not set. */
+  std::string allowlist;
+  std::string denylist;
+
+  /** CFG_UNREACHABLE=file, functions not to instrument in the format of
+   * CFG_DENYLIST, as printed by cfgdump -u. Empty if not set. */
+  std::string unreachable;
+
+  /** Parsed once per process. */
+  static const CfgOptions &get();
+};
+
+}  // namespace llvm
+
+#endif  // CFG_OPTIONS_H
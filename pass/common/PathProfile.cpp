@@ -0,0 +1,297 @@
+//===-- PathProfile.cpp - Ball-Larus path profiling -----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// An edge between two collapsed blocks is a jump into another one, or back
+// to the instrumented block of the same one. Back edges are found by a depth
+// first search from the entry, and the paths are numbered in post order so
+// that every node is numbered after its successors.
+//
+// The path register is an alloca promoted to SSA once every edge is
+// instrumented, so each edge costs at most one add.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/PathProfile.h"
+#include "common/GuardAnalysis.h"
+#include "common/Options.h"
+#include "common/ProfileCounters.h"
+#include "common/SectionWriter.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+
+#include <vector>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "path-profile"
+
+STATISTIC(NumProfiledFunctions, "Functions path profiled");
+STATISTIC(NumPathIds, "Path ids, ie. path counters");
+STATISTIC(NumBackEdges, "Back edges between collapsed blocks");
+STATISTIC(NumTooManyPaths, "Functions skipped, more paths than CFG_PATH_MAX");
+STATISTIC(NumUnplaceable, "Functions skipped, an edge takes no code");
+
+static const char *counters_section = "__sancov_path_cntrs";
+static const char *ctor_name = "cfg.module_ctor_paths";
+static const char *init_name = "__cfg_paths_init";
+
+namespace {
+
+/** Edge of the collapsed CFG, or a start edge standing for a back edge. */
+struct PathEdge {
+  unsigned src;
+  unsigned dst;
+  bool     back;
+  bool     start;
+  unsigned inc;
+};
+
+/** Edge of the IR, dst is none at an exit. */
+struct BlockEdge {
+  unsigned      src;
+  unsigned      dst;
+  unsigned      edge;
+  EdgePlacement place;
+};
+
+}  // namespace
+
+/** Number the paths of info.Func, instrument its edges and fill prof. Return
+ * false if the function is left alone. */
+static bool ProfileFunction(const FunctionGuardInfo &info,
+                            SectionWriter           &writer,
+                            FunctionPathProfile     &prof) {
+  Function      &F = *info.Func;
+  TimeTraceScope TimeScope("CfgPathProfile", F.getName());
+  if (!info.EntryGuard) { return false; }
+
+  const unsigned                   none = ~0u;
+  std::vector<BasicBlock *>        blocks;
+  DenseMap<BasicBlock *, unsigned> number;
+  for (auto &BB : F) {
+    number[&BB] = blocks.size();
+    blocks.push_back(&BB);
+  }
+  if (blocks.size() != info.BlockGuards.size()) { return false; }
+
+  /** one node per collapsed block, the exit last. head[i] if block i is the
+   * instrumented block of its node. */
+  DenseMap<Constant *, unsigned> node_of;
+  std::vector<Constant *>        guards;
+  std::vector<unsigned>          node(blocks.size(), none);
+  std::vector<bool>              head(blocks.size(), false);
+  for (unsigned i = 0; i < blocks.size(); i++) {
+    if (!info.BlockGuards[i]) { continue; }
+    auto it = node_of.insert(std::make_pair(info.BlockGuards[i], guards.size()));
+    if (it.second) { guards.push_back(info.BlockGuards[i]); }
+    node[i] = it.first->second;
+    head[i] = GetSancovPcGuardArg(*blocks[i]) == info.BlockGuards[i];
+  }
+  const unsigned entry = node[0];
+  const unsigned exit = guards.size();
+  const unsigned nodes = exit + 1;
+
+  std::vector<PathEdge>                               edges;
+  std::vector<std::vector<unsigned>>                  out(nodes);
+  DenseMap<std::pair<unsigned, unsigned>, unsigned>   edge_of;
+  auto add_edge = [&](unsigned src, unsigned dst) {
+    auto it = edge_of.insert(std::make_pair(std::make_pair(src, dst),
+                                            (unsigned)edges.size()));
+    if (it.second) {
+      edges.push_back({src, dst, false, false, 0});
+      out[src].push_back(edges.size() - 1);
+    }
+    return it.first->second;
+  };
+
+  std::vector<BlockEdge> block_edges;
+  for (unsigned i = 0; i < blocks.size(); i++) {
+    if (node[i] == none) { continue; }
+
+    SmallPtrSet<BasicBlock *, 8> seen;
+    std::vector<BasicBlock *>    succs;
+    for (BasicBlock *succ : successors(blocks[i])) {
+      if (seen.insert(succ).second) { succs.push_back(succ); }
+    }
+    if (succs.empty()) {
+      block_edges.push_back({i, none, add_edge(node[i], exit), AT_SRC});
+      continue;
+    }
+    for (BasicBlock *succ : succs) {
+      const unsigned j = number.lookup(succ);
+      if (node[j] == none || (node[j] == node[i] && !head[j])) {
+        continue;  // inside a collapsed block
+      }
+      block_edges.push_back({i, j, add_edge(node[i], node[j]),
+                             PlaceEdge(blocks[i], succ, succs.size())});
+    }
+  }
+
+  /** Depth-first search from the entry: an edge to a node on the stack is a
+   * back edge. */
+  std::vector<unsigned char>                    state(nodes, 0);
+  std::vector<unsigned>                         post;
+  std::vector<std::pair<unsigned, unsigned>>    stk;
+  std::vector<unsigned>                         back;
+  state[entry] = 1;
+  stk.push_back(std::make_pair(entry, 0));
+  while (!stk.empty()) {
+    const unsigned u = stk.back().first;
+    if (stk.back().second == out[u].size()) {
+      state[u] = 2;
+      post.push_back(u);
+      stk.pop_back();
+      continue;
+    }
+    const unsigned e = out[u][stk.back().second++];
+    const unsigned v = edges[e].dst;
+    if (state[v] == 1) {
+      edges[e].back = true;
+      back.push_back(e);
+    } else if (state[v] == 0) {
+      state[v] = 1;
+      stk.push_back(std::make_pair(v, 0));
+    }
+  }
+
+  /** A back edge u -> v ends a path at u and starts one at v. */
+  std::vector<unsigned> start_of(nodes, none);
+  for (unsigned e : back) {
+    const unsigned u = edges[e].src, v = edges[e].dst;
+    add_edge(u, exit);
+    if (v != entry && start_of[v] == none) {
+      start_of[v] = edges.size();
+      edges.push_back({entry, v, false, true, 0});
+      out[entry].push_back(start_of[v]);
+    }
+  }
+  NumBackEdges += back.size();
+
+  /** Ball-Larus numbering, successors first. */
+  const uint64_t        max = CfgOptions::get().path_max;
+  std::vector<uint64_t> paths(nodes, 0);
+  paths[exit] = 1;
+  for (unsigned u : post) {
+    if (u == exit) { continue; }
+    for (unsigned e : out[u]) {
+      if (edges[e].back) { continue; }
+      edges[e].inc = paths[u];
+      paths[u] += paths[edges[e].dst];
+      if (paths[u] > max) {
+        NumTooManyPaths++;
+        return false;
+      }
+    }
+  }
+
+  /** Every edge that changes the path id must take code. */
+  auto needs_code = [&](const BlockEdge &be) {
+    const PathEdge &edge = edges[be.edge];
+    return state[edge.src] == 2 &&
+           (be.dst == none || edge.back || edge.inc != 0);
+  };
+  for (const auto &be : block_edges) {
+    if (needs_code(be) && be.dst != none && be.place == NOWHERE) {
+      NumUnplaceable++;
+      return false;
+    }
+  }
+
+  // the record is written after the IR changes, check that it can be.
+  std::vector<Constant *> indexed(guards);
+  indexed.push_back(info.EntryGuard);
+  if (!writer.canIndex(indexed)) { return false; }
+
+  prof.Paths = paths[entry];
+  prof.EntryGuard = info.EntryGuard;
+  prof.Counters = CreateProfileCounters(F, prof.Paths, counters_section,
+                                        "__cfg_path_cntrs");
+  for (const auto &edge : edges) {
+    if (edge.back || state[edge.src] != 2) { continue; }
+    prof.Edges.push_back(std::make_pair(edge.start ? nullptr : guards[edge.src],
+                                        edge.dst == exit ? nullptr
+                                                         : guards[edge.dst]));
+    prof.Inc.push_back(edge.inc);
+  }
+  NumPathIds += prof.Paths;
+
+  Type       *Int32Ty = Type::getInt32Ty(F.getContext());
+  IRBuilder<> Entry(&*F.getEntryBlock().getFirstInsertionPt());
+  AllocaInst *reg = Entry.CreateAlloca(Int32Ty, nullptr, "cfg.path");
+  Entry.CreateStore(Entry.getInt32(0), reg);
+
+  /** counters[id + inc(u -> exit)]++ */
+  auto end_path = [&](Instruction *before, unsigned u) {
+    const PathEdge &to_exit = edges[edge_of.lookup(std::make_pair(u, exit))];
+    IRBuilder<>     IRB(before);
+    Value          *id = IRB.CreateLoad(Int32Ty, reg);
+    if (to_exit.inc) { id = IRB.CreateAdd(id, IRB.getInt32(to_exit.inc)); }
+    IncrementProfileCounter(before, prof.Counters, id);
+  };
+  for (const auto &be : block_edges) {
+    if (!needs_code(be)) { continue; }
+
+    const PathEdge &edge = edges[be.edge];
+    if (be.dst == none) {
+      end_path(ExitInsertionPoint(blocks[be.src]), edge.src);
+      continue;
+    }
+
+    Instruction *before =
+        EdgeInsertionPoint(blocks[be.src], blocks[be.dst], be.place);
+    assert(before && "edge checked for a placement above");
+    IRBuilder<> IRB(before);
+    if (edge.back) {
+      end_path(before, edge.src);
+      const unsigned start = start_of[edge.dst];
+      IRB.CreateStore(IRB.getInt32(start == none ? 0 : edges[start].inc), reg);
+    } else {
+      IRB.CreateStore(
+          IRB.CreateAdd(IRB.CreateLoad(Int32Ty, reg), IRB.getInt32(edge.inc)),
+          reg);
+    }
+  }
+
+  DominatorTree DT(F);
+  PromoteMemToReg({reg}, DT);
+  return true;
+}
+
+PreservedAnalyses llvm::InstrumentPathProfile(Module                &M,
+                                              ModuleAnalysisManager &MAM) {
+  const auto &result = MAM.getResult<GuardAnalysis>(M);
+  FunctionAnalysisManager &FAM =
+      MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+  SectionWriter writer(M, CFG_SEC_PATHS);
+  bool          changed = false;
+
+  for (const auto &info : result.Functions) {
+    FunctionPathProfile prof;
+    prof.Func = info.Func;
+    if (!ProfileFunction(info, writer, prof)) { continue; }
+
+    writer.addPathProfile(prof);
+    FAM.invalidate(*info.Func, PreservedAnalyses::none());
+    NumProfiledFunctions++;
+    changed = true;
+  }
+  writer.finalize();
+
+  if (!changed) { return PreservedAnalyses::all(); }
+  CreateProfileInitCall(M, counters_section, ctor_name, init_name);
+  return PreservedAnalyses::none();
+}
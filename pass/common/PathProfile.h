@@ -0,0 +1,57 @@
+//===-- PathProfile.h - Ball-Larus path profiling ---------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Count the acyclic paths of a function (Ball and Larus): the back edges of
+// the CFG of its collapsed blocks (see GuardAnalysis) are replaced by an edge
+// from the entry to their target and an edge from their source to the exit,
+// and the edges of the resulting DAG get increments such that the sum along
+// every path from the entry to the exit is a distinct id in [0, paths).
+//
+// A path register starts at 0, is increased along the edges, and indexes a
+// 64-bit counter of the function when the path ends, at an exit or a back
+// edge, then restarts. The counters of a module live in __sancov_path_cntrs
+// and are handed to __cfg_paths_init(start, stop) (see wrapper/cfgprof.c);
+// the increments go to __sancov_paths (SANCOV_CFG_PATHS), from which
+// cfgdump -P turns each id back into its guards.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_PATH_PROFILE_H
+#define CFG_PATH_PROFILE_H
+
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+/** Path numbering of a function, in guard space. */
+struct FunctionPathProfile {
+  Function       *Func{nullptr};
+  GlobalVariable *Counters{nullptr};
+  Constant       *EntryGuard{nullptr};
+  unsigned        Paths{0};
+  /** edges of the DAG, Src is nullptr on the edges that start a path after a
+   * back edge and Dst on the edges that end one. */
+  std::vector<std::pair<Constant *, Constant *>> Edges;
+  /** added to the path id along each edge. */
+  std::vector<unsigned> Inc;
+};
+
+/** Instrument the functions of M with at most CfgOptions::path_max paths
+ * and emit their __sancov_paths chunks. */
+PreservedAnalyses InstrumentPathProfile(Module &M, ModuleAnalysisManager &MAM);
+
+}  // namespace llvm
+
+#endif  // CFG_PATH_PROFILE_H
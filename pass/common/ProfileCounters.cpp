@@ -0,0 +1,133 @@
+//===-- ProfileCounters.cpp - counters shared by the profiles -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/ProfileCounters.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/TargetParser/Triple.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <string>
+
+using namespace llvm;
+
+EdgePlacement llvm::PlaceEdge(BasicBlock *src, BasicBlock *dst,
+                              unsigned distinct_succs) {
+  if (!src) { return AT_DST; }  // from the caller to the entry block
+
+  Instruction *TI = src->getTerminator();
+  if (distinct_succs <= 1 && !isa<CatchSwitchInst>(TI)) { return AT_SRC; }
+  if (dst->getSinglePredecessor() == src &&
+      dst->getFirstInsertionPt() != dst->end()) {
+    return AT_DST;
+  }
+  if (isa<IndirectBrInst>(TI) || isa<CallBrInst>(TI) || dst->isEHPad()) {
+    return NOWHERE;
+  }
+  return SPLIT;
+}
+
+Instruction *llvm::EdgeInsertionPoint(BasicBlock *src, BasicBlock *dst,
+                                      EdgePlacement place) {
+  switch (place) {
+    case AT_SRC:
+      return src->getTerminator();
+    case AT_DST:
+      return &*dst->getFirstInsertionPt();
+    case SPLIT: {
+      Instruction *TI = src->getTerminator();
+      unsigned     idx = 0;
+      while (TI->getSuccessor(idx) != dst) { idx++; }
+      BasicBlock *split = SplitCriticalEdge(
+          TI, idx, CriticalEdgeSplittingOptions().setMergeIdenticalEdges());
+      return split ? split->getTerminator() : nullptr;
+    }
+    case NOWHERE:
+      break;
+  }
+  return nullptr;
+}
+
+Instruction *llvm::ExitInsertionPoint(BasicBlock *BB) {
+  if (auto *CI = BB->getTerminatingMustTailCall()) { return CI; }
+
+  Instruction *TI = BB->getTerminator();
+  if (isa<UnreachableInst>(TI) && TI->getPrevNode() &&
+      isa<CallBase>(TI->getPrevNode())) {
+    return TI->getPrevNode();
+  }
+  return TI;
+}
+
+GlobalVariable *llvm::CreateProfileCounters(Function &F, unsigned count,
+                                            const char *section,
+                                            const char *name) {
+  Module &M = *F.getParent();
+  auto   *ArrayTy = ArrayType::get(Type::getInt64Ty(M.getContext()), count);
+  auto   *counters =
+      new GlobalVariable(M, ArrayTy, false, GlobalVariable::PrivateLinkage,
+                         Constant::getNullValue(ArrayTy), name);
+  Triple TargetTriple(M.getTargetTriple());
+  if (TargetTriple.supportsCOMDAT() &&
+      (TargetTriple.isOSBinFormatELF() || !F.isInterposable())) {
+    if (auto *Comdat = getOrCreateFunctionComdat(F, TargetTriple)) {
+      counters->setComdat(Comdat);
+    }
+  }
+  counters->setSection(section);
+  counters->setAlignment(Align(sizeof(uint64_t)));
+  return counters;
+}
+
+void llvm::IncrementProfileCounter(Instruction *before,
+                                   GlobalVariable *counters, Value *index) {
+  // load, add and store like the inline counters of sancov.
+  IRBuilder<> IRB(before);
+  Type       *Int64Ty = IRB.getInt64Ty();
+  Value      *ptr = IRB.CreateInBoundsGEP(
+      counters->getValueType(), counters,
+      {IRB.getInt64(0), IRB.CreateZExtOrTrunc(index, Int64Ty)});
+  LoadInst  *load = IRB.CreateLoad(Int64Ty, ptr);
+  StoreInst *store = IRB.CreateStore(IRB.CreateAdd(load, IRB.getInt64(1)), ptr);
+
+  LLVMContext &ctx = before->getContext();
+  MDNode      *none = MDNode::get(ctx, {});
+  load->setMetadata(ctx.getMDKindID("nosanitize"), none);
+  store->setMetadata(ctx.getMDKindID("nosanitize"), none);
+}
+
+void llvm::CreateProfileInitCall(Module &M, const char *section,
+                                 const char *ctor_name, const char *init) {
+  Type  *PtrTy = PointerType::getUnqual(Type::getInt64Ty(M.getContext()));
+  Triple TargetTriple(M.getTargetTriple());
+  auto   bound = [&](const char *prefix) {
+    auto *global = new GlobalVariable(
+        M, Type::getInt64Ty(M.getContext()), false,
+        TargetTriple.isOSBinFormatCOFF() ? GlobalVariable::ExternalLinkage
+                                         : GlobalVariable::ExternalWeakLinkage,
+        nullptr, std::string(prefix) + section);
+    global->setVisibility(GlobalValue::HiddenVisibility);
+    return global;
+  };
+  GlobalVariable *start = bound("__start_");
+  GlobalVariable *stop = bound("__stop_");
+
+  Function *ctor = createSanitizerCtorAndInitFunctions(
+                       M, ctor_name, init, {PtrTy, PtrTy}, {start, stop})
+                       .first;
+  if (TargetTriple.supportsCOMDAT()) {
+    ctor->setComdat(M.getOrInsertComdat(ctor_name));
+    appendToGlobalCtors(M, ctor, 2, ctor);
+  } else {
+    appendToGlobalCtors(M, ctor, 2);
+  }
+}
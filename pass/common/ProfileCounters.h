@@ -0,0 +1,66 @@
+//===-- ProfileCounters.h - counters shared by the profiles -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// 64-bit counter arrays of the edge and path profiles, where to put code on
+// an edge, and the module constructor that hands the counters of a linked
+// object to the runtime in wrapper/cfgprof.c.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_PROFILE_COUNTERS_H
+#define CFG_PROFILE_COUNTERS_H
+
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+
+namespace llvm {
+
+/** Where the code of an edge goes. */
+enum EdgePlacement {
+  AT_SRC,   // before the terminator of the source, its only successor
+  AT_DST,   // at the start of the destination, its only predecessor
+  SPLIT,    // in a new block on a critical edge
+  NOWHERE,  // into an EH pad, out of an indirectbr or callbr
+};
+
+/** Placement of code on the edge src -> dst, src has `distinct_succs`
+ * distinct successors. src is nullptr for the edge from the caller. */
+EdgePlacement PlaceEdge(BasicBlock *src, BasicBlock *dst,
+                        unsigned distinct_succs);
+
+/** Instruction before which the code of the edge goes, splitting the edge if
+ * `place` is SPLIT. nullptr if it cannot be placed. */
+Instruction *EdgeInsertionPoint(BasicBlock *src, BasicBlock *dst,
+                                EdgePlacement place);
+
+/** Instruction before which the code at the end of the exit block BB goes: a
+ * musttail call stays right before its ret, and a noreturn call is counted
+ * before it runs. */
+Instruction *ExitInsertionPoint(BasicBlock *BB);
+
+/** Private array of `count` zeroed 64-bit counters of F in `section`, in the
+ * comdat of F as the guard array of sancov. */
+GlobalVariable *CreateProfileCounters(Function &F, unsigned count,
+                                      const char *section, const char *name);
+
+/** counters[index]++ before `before`, hidden from the sanitizers. */
+void IncrementProfileCounter(Instruction *before, GlobalVariable *counters,
+                             Value *index);
+
+/** Module constructor `ctor` calling init(__start_section, __stop_section),
+ * once per linked object thanks to the comdat. */
+void CreateProfileInitCall(Module &M, const char *section, const char *ctor,
+                           const char *init);
+
+}  // namespace llvm
+
+#endif  // CFG_PROFILE_COUNTERS_H
@@ -0,0 +1,868 @@
+//===-- SectionWriter.cpp - emit cfg sections from guard info -------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/SectionWriter.h"
+#include "common/Options.h"
+#include "common/TargetDistance.h"
+
+#include "api/sancov_sec.h"
+
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "cfg-sections"
+
+STATISTIC(NumEdges, "Edges emitted");
+STATISTIC(NumCalls, "Call records emitted");
+STATISTIC(NumEntries, "Entry records emitted");
+STATISTIC(NumFuncs, "Function table records emitted");
+STATISTIC(NumIndirectCalls, "Indirect call records emitted");
+STATISTIC(NumExits, "Exit records emitted");
+STATISTIC(NumSkippedGuards, "Records skipped, guard outside the guard array");
+STATISTIC(NumMetadataBytes, "Bytes of cfg metadata");
+
+static const char *edge_section = "__sancov_cfg_edges";
+static const char *call_section = "__sancov_func";
+static const char *entry_section = "__sancov_entries";
+static const char *blocks_section = "__sancov_blocks";
+static const char *eprof_section = "__sancov_eprof";
+static const char *paths_section = "__sancov_paths";
+static const char *dist_section = "__sancov_dist";
+static const char *weights_section = "__sancov_weights";
+static const char *loops_section = "__sancov_loops";
+static const char *funcs_section = "__sancov_funcs";
+static const char *names_section = "__sancov_func_names";
+static const char *icalls_section = "__sancov_icalls";
+static const char *returns_section = "__sancov_returns";
+static const char *ids_section = "__sancov_ids";
+
+SectionWriter::SectionWriter(Module &M, unsigned sections)
+    : mod(M), DL(M.getDataLayout()), sections(sections) {
+  format = CfgOptions::get().format;
+  PtrTy = PointerType::get(Type::getInt32Ty(mod.getContext()), 0);
+  Int32Ty = Type::getInt32Ty(mod.getContext());
+  IntPtrTy = DL.getIntPtrType(mod.getContext());
+  TargetTriple = Triple(mod.getTargetTriple());
+}
+
+bool SectionWriter::RelativePointers() const {
+  return format == SANCOV_CFG_REL || format == SANCOV_CFG_VARINT;
+}
+
+uint8_t SectionWriter::ChunkVersion(uint8_t kind) const {
+  if (format == 1) { return SANCOV_CFG_V2; }
+  if (kind != SANCOV_CFG_EDGES && kind != SANCOV_CFG_CALLS &&
+      kind != SANCOV_CFG_ENTRIES && format == SANCOV_CFG_VARINT) {
+    return SANCOV_CFG_REL;
+  }
+  return format;
+}
+
+Constant *SectionWriter::FunctionRef(Function *F) {
+  if (RelativePointers() && !F->isDSOLocal()) {
+    return DSOLocalEquivalent::get(F);
+  }
+  return F;
+}
+
+Comdat *SectionWriter::RecordComdat(Function &F) {
+  if (TargetTriple.supportsCOMDAT() &&
+      (TargetTriple.isOSBinFormatELF() || !F.isInterposable())) {
+    return getOrCreateFunctionComdat(F, TargetTriple);
+  }
+  return nullptr;
+}
+
+GlobalVariable *SectionWriter::CreateGlobal(Function &F, Type *Ty,
+                                            const std::string &name,
+                                            const char        *section,
+                                            uint64_t           align) {
+  auto *global = new GlobalVariable(mod, Ty, false,
+                                    GlobalVariable::PrivateLinkage, nullptr, name);
+  // same comdat as the guard array of F (see SanitizerCoverage), so the
+  // records of a discarded or deduplicated function go away with it.
+  if (auto *Comdat = RecordComdat(F)) { global->setComdat(Comdat); }
+  // SHF_LINK_ORDER on the section of F: lld collects the members of a
+  // comdat group one by one, and keeps the records only if F is kept.
+  if (TargetTriple.isOSBinFormatELF()) {
+    global->setMetadata(LLVMContext::MD_associated,
+                        MDNode::get(mod.getContext(), ValueAsMetadata::get(&F)));
+  }
+  global->setSection(section);
+  global->setConstant(true);
+  global->setAlignment(Align(align));
+  NumMetadataBytes += DL.getTypeAllocSize(Ty).getFixedValue();
+
+  // sancov_pcs parallels the other metadata section(s). Optimizers (e.g.
+  // GlobalOpt/ConstantMerge) may not discard sancov_pcs and the other
+  // section(s) as a unit, so we conservatively retain all unconditionally in
+  // the compiler.
+  //
+  // With comdat (COFF/ELF), the linker can guarantee the associated sections
+  // will be retained or discarded as a unit, so llvm.compiler.used is
+  // sufficient. Otherwise, conservatively make all of them retained by the
+  // linker.
+  if (global->hasComdat()) {
+    CompilerUsed.push_back(global);
+  } else {
+    Used.push_back(global);
+  }
+  return global;
+}
+
+GlobalVariable *SectionWriter::CreateArray(Function                      &F,
+                                           const std::vector<Constant *> &init,
+                                           const std::string             &name,
+                                           const char *section) {
+  auto *ArrayTy = ArrayType::get(PtrTy, init.size());
+  auto *global = CreateGlobal(F, ArrayTy, name, section,
+                              DL.getTypeStoreSize(PtrTy).getFixedValue());
+  global->setInitializer(ConstantArray::get(ArrayTy, init));
+  return global;
+}
+
+GlobalVariable *SectionWriter::CreateChunk(Function &F, uint8_t kind,
+                                           Constant             *guards,
+                                           uint32_t              count,
+                                           ArrayRef<ChunkColumn> columns,
+                                           const std::string    &name,
+                                           const char           *section) {
+  LLVMContext  &ctx = mod.getContext();
+  const bool    rel = RelativePointers();
+  const uint8_t version = ChunkVersion(kind);
+  Type        *SlotTy = rel ? Int32Ty : PtrTy;
+  Type        *Int8Ty = Type::getInt8Ty(ctx);
+
+  // natural layout matches struct SancovCfgHeaderV2 (SancovCfgHeaderRel,
+  // SancovCfgHeaderVarint), and the alloc size of the struct pads the chunk
+  // to 8 (4) bytes.
+  std::vector<Type *> types = {Type::getInt16Ty(ctx), Int8Ty, Int8Ty, Int32Ty,
+                               SlotTy};
+  uint32_t            stream = 0;
+  if (version == SANCOV_CFG_VARINT) { types.push_back(Int32Ty); }
+  const unsigned header = types.size();
+  for (const auto &column : columns) {
+    Type *ElemTy = column.kind == COL_PTR ? SlotTy
+                   : column.kind == COL_U8 ? Int8Ty
+                                           : Int32Ty;  // COL_U32, COL_OFF
+    types.push_back(ArrayType::get(ElemTy, column.values.size()));
+    if (column.kind == COL_U8) { stream += column.values.size(); }
+  }
+  auto *ChunkTy = StructType::get(ctx, types);
+  auto *chunk = CreateGlobal(
+      F, ChunkTy, name, section,
+      rel ? sizeof(int32_t) : DL.getTypeStoreSize(PtrTy).getFixedValue());
+
+  /** target minus the address of the slot at `index` in the chunk, which
+   * the assembler resolves to a PC-relative relocation: the linker fills it
+   * in, the loader never touches it. */
+  auto offset = [&](Constant *target, ArrayRef<unsigned> index) -> Constant * {
+    if (!target) { return ConstantInt::get(Int32Ty, 0); }
+
+    std::vector<Constant *> indices = {ConstantInt::get(Int32Ty, 0)};
+    for (unsigned i : index) { indices.push_back(ConstantInt::get(Int32Ty, i)); }
+    Constant *addr =
+        ConstantExpr::getInBoundsGetElementPtr(ChunkTy, chunk, indices);
+    Constant *diff =
+        ConstantExpr::getSub(ConstantExpr::getPtrToInt(target, IntPtrTy),
+                             ConstantExpr::getPtrToInt(addr, IntPtrTy));
+    return ConstantExpr::getTrunc(diff, Int32Ty);
+  };
+  /** Pointer slot at `index` in the chunk, an offset in rel. */
+  auto slot = [&](Constant *target, ArrayRef<unsigned> index) -> Constant * {
+    if (!target) { return Constant::getNullValue(SlotTy); }
+    if (!rel) { return ConstantExpr::getPointerCast(target, PtrTy); }
+    return offset(target, index);
+  };
+
+  std::vector<Constant *> fields = {
+      ConstantInt::get(Type::getInt16Ty(ctx), SANCOV_CFG_MAGIC),
+      ConstantInt::get(Int8Ty, version),
+      ConstantInt::get(Int8Ty, kind),
+      ConstantInt::get(Int32Ty, count),
+      slot(guards, {4}),
+  };
+  if (version == SANCOV_CFG_VARINT) {
+    fields.push_back(ConstantInt::get(Int32Ty, stream));
+  }
+  for (unsigned col = 0; col < columns.size(); col++) {
+    const unsigned          field = header + col;
+    std::vector<Constant *> values;
+    values.reserve(columns[col].values.size());
+    for (unsigned i = 0; i < columns[col].values.size(); i++) {
+      Constant *value = columns[col].values[i];
+      if (columns[col].kind == COL_PTR) {
+        value = slot(value, {field, i});
+      } else if (columns[col].kind == COL_OFF) {
+        value = offset(value, {field, i});
+      }
+      values.push_back(value);
+    }
+    fields.push_back(
+        ConstantArray::get(cast<ArrayType>(types[field]), values));
+  }
+
+  chunk->setInitializer(ConstantStruct::get(ChunkTy, fields));
+  return chunk;
+}
+
+bool SectionWriter::GuardIndex(Constant *guard, GlobalVariable *&base,
+                               uint32_t &index) {
+  uint64_t        offset;
+  GlobalVariable *array = GetGuardBase(guard, DL, offset);
+  // 4-byte guards, or 1-byte inline counters and flags.
+  uint64_t elem = sizeof(uint32_t);
+  if (array && array->getValueType()->isArrayTy()) {
+    elem = DL.getTypeAllocSize(array->getValueType()->getArrayElementType())
+               .getFixedValue();
+  }
+  if (!array || (base && array != base) || offset % elem) {
+    std::cerr << "\033[01;31m[!]\033[0;m Guard is not in the guard array "
+                 "of its function, skipped"
+              << std::endl;
+    NumSkippedGuards++;
+    return false;
+  }
+
+  base = array;
+  index = offset / elem;
+  return true;
+}
+
+bool SectionWriter::canIndex(ArrayRef<Constant *> guards) {
+  GlobalVariable *base = nullptr;
+  uint32_t        index;
+  for (auto *guard : guards) {
+    if (guard && !GuardIndex(guard, base, index)) { return false; }
+  }
+  return true;
+}
+
+void SectionWriter::addFunctionV1(const FunctionGuardInfo &info) {
+  Function &F = *info.Func;
+
+  if ((sections & CFG_SEC_EDGES) && !info.Edges.empty()) {
+    std::vector<Constant *> edges;
+    edges.reserve(info.Edges.size() * 2);
+    for (const auto &edge : info.Edges) {
+      // guards are i32, inline counters and flags i8.
+      edges.push_back(ConstantExpr::getPointerCast(edge.first, PtrTy));
+      edges.push_back(ConstantExpr::getPointerCast(edge.second, PtrTy));
+    }
+
+    std::ostringstream oss;
+    oss << "__cfg_edges_" << func_cnt;
+    CreateArray(F, edges, oss.str(), edge_section);
+    func_cnt++;
+    NumEdges += info.Edges.size();
+  }
+
+  if ((sections & CFG_SEC_CALLS) && !info.Calls.empty()) {
+    std::vector<Constant *> calls;
+    calls.reserve(info.Calls.size() * 2);
+    for (const auto &call : info.Calls) {
+      // cast function to its address
+      calls.push_back(ConstantExpr::getPointerCast(call.first, PtrTy));
+      calls.push_back(ConstantExpr::getPointerCast(call.second, PtrTy));
+    }
+
+    std::ostringstream oss;
+    oss << "__func_calls_" << call_cnt;
+    CreateArray(F, calls, oss.str(), call_section);
+    call_cnt++;
+    NumCalls += info.Calls.size();
+  }
+
+  if ((sections & CFG_SEC_ENTRIES) && info.EntryGuard) {
+    std::ostringstream oss;
+    oss << "__func_entries_" << entry_cnt;
+    CreateArray(F,
+                {ConstantExpr::getPointerCast(&F, PtrTy),
+                 ConstantExpr::getPointerCast(info.EntryGuard, PtrTy)},
+                oss.str(), entry_section);
+    entry_cnt++;
+    NumEntries++;
+  }
+}
+
+void SectionWriter::addFunctionV2(const FunctionGuardInfo &info) {
+  Function       &F = *info.Func;
+  GlobalVariable *base = nullptr;
+
+  if ((sections & CFG_SEC_EDGES) && !info.Edges.empty()) {
+    std::vector<Constant *> src, dst;
+    for (const auto &edge : info.Edges) {
+      uint32_t s, d;
+      if (GuardIndex(edge.first, base, s) && GuardIndex(edge.second, base, d)) {
+        src.push_back(ConstantInt::get(Int32Ty, s));
+        dst.push_back(ConstantInt::get(Int32Ty, d));
+      }
+    }
+
+    if (!src.empty()) {
+      std::ostringstream oss;
+      oss << "__cfg_edges_" << func_cnt;
+      CreateChunk(F, SANCOV_CFG_EDGES, base, src.size(),
+                  {{COL_U32, src}, {COL_U32, dst}}, oss.str(), edge_section);
+      func_cnt++;
+      NumEdges += src.size();
+    }
+  }
+
+  if ((sections & CFG_SEC_CALLS) && !info.Calls.empty()) {
+    // group the calling guards by callee, in order of first call.
+    MapVector<Function *, std::vector<Constant *>> by_callee;
+    for (const auto &call : info.Calls) {
+      uint32_t g;
+      if (GuardIndex(call.first, base, g)) {
+        by_callee[call.second].push_back(ConstantInt::get(Int32Ty, g));
+      }
+    }
+
+    if (!by_callee.empty()) {
+      std::vector<Constant *> callees, ends, guards;
+      for (auto &callee : by_callee) {
+        callees.push_back(FunctionRef(callee.first));
+        guards.insert(guards.end(), callee.second.begin(),
+                      callee.second.end());
+        ends.push_back(ConstantInt::get(Int32Ty, guards.size()));
+      }
+
+      std::ostringstream oss;
+      oss << "__func_calls_" << call_cnt;
+      CreateChunk(F, SANCOV_CFG_CALLS, base, callees.size(),
+                  {{COL_PTR, callees}, {COL_U32, ends}, {COL_U32, guards}},
+                  oss.str(), call_section);
+      call_cnt++;
+      NumCalls += guards.size();
+    }
+  }
+
+  if ((sections & CFG_SEC_ENTRIES) && info.EntryGuard && !RecordComdat(F)) {
+    // nothing is dropped without a comdat, finalize() emits a single chunk.
+    if (Entries.empty()) { EntriesOwner = &F; }
+    Entries.push_back(FunctionRef(&F));
+    EntryGuards.push_back(info.EntryGuard);
+    NumEntries++;
+  } else if ((sections & CFG_SEC_ENTRIES) && info.EntryGuard) {
+    // one record per chunk: its header is the cost of dropping it with F.
+    std::ostringstream oss;
+    oss << "__func_entries_" << entry_cnt;
+    CreateChunk(F, SANCOV_CFG_ENTRIES, nullptr, 1,
+                {{COL_PTR, {FunctionRef(&F)}}, {COL_PTR, {info.EntryGuard}}},
+                oss.str(), entry_section);
+    entry_cnt++;
+    NumEntries++;
+  }
+}
+
+static uint64_t ZigZag(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+/** Bytes of a varint stream as a COL_U8 column. */
+static std::vector<Constant *> StreamColumn(LLVMContext       &ctx,
+                                            const std::string &stream) {
+  std::vector<Constant *> bytes;
+  bytes.reserve(stream.size());
+  for (char c : stream) {
+    bytes.push_back(ConstantInt::get(Type::getInt8Ty(ctx), (uint8_t)c));
+  }
+  return bytes;
+}
+
+void SectionWriter::addFunctionVarint(const FunctionGuardInfo &info) {
+  Function       &F = *info.Func;
+  LLVMContext    &ctx = mod.getContext();
+  GlobalVariable *base = nullptr;
+
+  if ((sections & CFG_SEC_EDGES) && !info.Edges.empty()) {
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    for (const auto &edge : info.Edges) {
+      uint32_t s, d;
+      if (GuardIndex(edge.first, base, s) && GuardIndex(edge.second, base, d)) {
+        edges.push_back(std::make_pair(s, d));
+      }
+    }
+
+    if (!edges.empty()) {
+      // sorted, src only grows and dst is close to src.
+      std::sort(edges.begin(), edges.end());
+      std::string        stream;
+      raw_string_ostream os(stream);
+      uint32_t           prev = 0;
+      for (const auto &edge : edges) {
+        encodeULEB128(edge.first - prev, os);
+        encodeULEB128(ZigZag((int64_t)edge.second - (int64_t)edge.first), os);
+        prev = edge.first;
+      }
+      os.flush();
+
+      std::ostringstream oss;
+      oss << "__cfg_edges_" << func_cnt;
+      CreateChunk(F, SANCOV_CFG_EDGES, base, edges.size(),
+                  {{COL_U8, StreamColumn(ctx, stream)}}, oss.str(),
+                  edge_section);
+      func_cnt++;
+      NumEdges += edges.size();
+    }
+  }
+
+  if ((sections & CFG_SEC_CALLS) && !info.Calls.empty()) {
+    MapVector<Function *, std::vector<uint32_t>> by_callee;
+    for (const auto &call : info.Calls) {
+      uint32_t g;
+      if (GuardIndex(call.first, base, g)) {
+        by_callee[call.second].push_back(g);
+      }
+    }
+
+    if (!by_callee.empty()) {
+      std::vector<Constant *> callees;
+      std::string             stream;
+      raw_string_ostream      os(stream);
+      for (auto &callee : by_callee) {
+        std::vector<uint32_t> &guards = callee.second;
+        std::sort(guards.begin(), guards.end());
+        callees.push_back(FunctionRef(callee.first));
+        NumCalls += guards.size();
+        encodeULEB128(guards.size(), os);
+        encodeULEB128(guards[0], os);
+        for (size_t i = 1; i < guards.size(); i++) {
+          encodeULEB128(guards[i] - guards[i - 1], os);
+        }
+      }
+      os.flush();
+
+      std::ostringstream oss;
+      oss << "__func_calls_" << call_cnt;
+      CreateChunk(F, SANCOV_CFG_CALLS, base, callees.size(),
+                  {{COL_PTR, callees}, {COL_U8, StreamColumn(ctx, stream)}},
+                  oss.str(), call_section);
+      call_cnt++;
+    }
+  }
+
+  uint32_t entry;
+  if ((sections & CFG_SEC_ENTRIES) && info.EntryGuard &&
+      GuardIndex(info.EntryGuard, base, entry)) {
+    std::string        stream;
+    raw_string_ostream os(stream);
+    encodeULEB128(entry, os);
+    os.flush();
+
+    std::ostringstream oss;
+    oss << "__func_entries_" << entry_cnt;
+    CreateChunk(F, SANCOV_CFG_ENTRIES, base, 1,
+                {{COL_PTR, {FunctionRef(&F)}},
+                 {COL_U8, StreamColumn(ctx, stream)}},
+                oss.str(), entry_section);
+    entry_cnt++;
+    NumEntries++;
+  }
+}
+
+void SectionWriter::addBlocks(const FunctionGuardInfo &info) {
+  const FunctionGuardInfo::BlockGraph &graph = info.Blocks;
+  if (!(sections & CFG_SEC_BLOCKS) || graph.Guards.empty()) { return; }
+
+  GlobalVariable         *base = nullptr;
+  std::vector<Constant *> guards, idom, ipdom, ends, call_ends, succs, callees;
+  for (auto *guard : graph.Guards) {
+    uint32_t g = SANCOV_CFG_NONE;
+    if (guard && !GuardIndex(guard, base, g)) { return; }
+    guards.push_back(ConstantInt::get(Int32Ty, g));
+  }
+  for (unsigned i = 0; i < graph.Guards.size(); i++) {
+    idom.push_back(ConstantInt::get(Int32Ty, graph.IDom[i]));
+    ipdom.push_back(ConstantInt::get(Int32Ty, graph.IPDom[i]));
+    ends.push_back(ConstantInt::get(Int32Ty, graph.SuccEnd[i]));
+    call_ends.push_back(ConstantInt::get(Int32Ty, graph.CallEnd[i]));
+  }
+  for (unsigned succ : graph.Succs) {
+    succs.push_back(ConstantInt::get(Int32Ty, succ));
+  }
+  for (auto *callee : graph.Callees) { callees.push_back(FunctionRef(callee)); }
+
+  std::ostringstream oss;
+  oss << "__cfg_blocks_" << blocks_cnt;
+  CreateChunk(*info.Func, SANCOV_CFG_BLOCKS, base, guards.size(),
+              {{COL_U32, guards},
+               {COL_U32, idom},
+               {COL_U32, ipdom},
+               {COL_U32, ends},
+               {COL_U32, call_ends},
+               {COL_U32, succs},
+               {COL_PTR, callees}},
+              oss.str(), blocks_section);
+  blocks_cnt++;
+}
+
+void SectionWriter::addEdgeProfile(const FunctionEdgeProfile &prof) {
+  if (!(sections & CFG_SEC_EPROF)) { return; }
+
+  GlobalVariable         *base = nullptr;
+  std::vector<Constant *> guards, src, dst, counter;
+  for (auto *guard : prof.Guards) {
+    uint32_t g = SANCOV_CFG_NONE;
+    if (guard && !GuardIndex(guard, base, g)) { return; }
+    guards.push_back(ConstantInt::get(Int32Ty, g));
+  }
+  for (unsigned i = 0; i < prof.Edges.size(); i++) {
+    src.push_back(ConstantInt::get(Int32Ty, prof.Edges[i].first));
+    dst.push_back(ConstantInt::get(Int32Ty, prof.Edges[i].second));
+    counter.push_back(ConstantInt::get(Int32Ty, prof.Counter[i]));
+  }
+
+  std::ostringstream oss;
+  oss << "__cfg_eprof_" << eprof_cnt;
+  CreateChunk(*prof.Func, SANCOV_CFG_EPROF, base, prof.Edges.size(),
+              {{COL_PTR, {prof.Counters}},
+               {COL_U32, {ConstantInt::get(Int32Ty, guards.size())}},
+               {COL_U32, guards},
+               {COL_U32, src},
+               {COL_U32, dst},
+               {COL_U32, counter}},
+              oss.str(), eprof_section);
+  eprof_cnt++;
+}
+
+void SectionWriter::addPathProfile(const FunctionPathProfile &prof) {
+  if (!(sections & CFG_SEC_PATHS)) { return; }
+
+  GlobalVariable         *base = nullptr;
+  uint32_t                entry;
+  std::vector<Constant *> src, dst, inc;
+  if (!GuardIndex(prof.EntryGuard, base, entry)) { return; }
+  for (unsigned i = 0; i < prof.Edges.size(); i++) {
+    uint32_t s = SANCOV_CFG_NONE, d = SANCOV_CFG_NONE;
+    if ((prof.Edges[i].first && !GuardIndex(prof.Edges[i].first, base, s)) ||
+        (prof.Edges[i].second && !GuardIndex(prof.Edges[i].second, base, d))) {
+      return;
+    }
+    src.push_back(ConstantInt::get(Int32Ty, s));
+    dst.push_back(ConstantInt::get(Int32Ty, d));
+    inc.push_back(ConstantInt::get(Int32Ty, prof.Inc[i]));
+  }
+
+  std::ostringstream oss;
+  oss << "__cfg_paths_" << paths_cnt;
+  CreateChunk(*prof.Func, SANCOV_CFG_PATHS, base, prof.Edges.size(),
+              {{COL_PTR, {prof.Counters}},
+               {COL_U32, {ConstantInt::get(Int32Ty, prof.Paths)}},
+               {COL_U32, {ConstantInt::get(Int32Ty, entry)}},
+               {COL_U32, src},
+               {COL_U32, dst},
+               {COL_U32, inc}},
+              oss.str(), paths_section);
+  paths_cnt++;
+}
+
+void SectionWriter::addEdgeWeights(const FunctionEdgeWeights &weights) {
+  if (!(sections & CFG_SEC_WEIGHTS)) { return; }
+
+  GlobalVariable         *base = nullptr;
+  std::vector<Constant *> src, dst, prob, freq;
+  for (unsigned i = 0; i < weights.Edges.size(); i++) {
+    uint32_t s, d;
+    if (!GuardIndex(weights.Edges[i].first, base, s) ||
+        !GuardIndex(weights.Edges[i].second, base, d)) {
+      continue;
+    }
+    src.push_back(ConstantInt::get(Int32Ty, s));
+    dst.push_back(ConstantInt::get(Int32Ty, d));
+    prob.push_back(ConstantInt::get(Int32Ty, weights.Prob[i]));
+    freq.push_back(ConstantInt::get(Int32Ty, weights.Freq[i]));
+  }
+  if (src.empty()) { return; }
+
+  std::ostringstream oss;
+  oss << "__cfg_weights_" << weights_cnt;
+  CreateChunk(*weights.Func, SANCOV_CFG_WEIGHTS, base, src.size(),
+              {{COL_U32, {ConstantInt::get(Int32Ty, weights.Profile)}},
+               {COL_U32, src},
+               {COL_U32, dst},
+               {COL_U32, prob},
+               {COL_U32, freq}},
+              oss.str(), weights_section);
+  weights_cnt++;
+}
+
+void SectionWriter::addLoops(const FunctionLoops &loops) {
+  if (!(sections & CFG_SEC_LOOPS)) { return; }
+
+  GlobalVariable         *base = nullptr;
+  std::vector<Constant *> headers, parents, depths, ends, latches;
+  for (unsigned i = 0; i < loops.Headers.size(); i++) {
+    uint32_t h;
+    if (!GuardIndex(loops.Headers[i], base, h)) { return; }
+    headers.push_back(ConstantInt::get(Int32Ty, h));
+    parents.push_back(ConstantInt::get(Int32Ty, loops.Parent[i]));
+    depths.push_back(ConstantInt::get(Int32Ty, loops.Depth[i]));
+    ends.push_back(ConstantInt::get(Int32Ty, loops.LatchEnd[i]));
+  }
+  for (auto *latch : loops.Latches) {
+    uint32_t l;
+    if (!GuardIndex(latch, base, l)) { return; }
+    latches.push_back(ConstantInt::get(Int32Ty, l));
+  }
+
+  std::ostringstream oss;
+  oss << "__cfg_loops_" << loops_cnt;
+  CreateChunk(*loops.Func, SANCOV_CFG_LOOPS, base, headers.size(),
+              {{COL_U32, headers},
+               {COL_U32, parents},
+               {COL_U32, depths},
+               {COL_U32, ends},
+               {COL_U32, latches}},
+              oss.str(), loops_section);
+  loops_cnt++;
+}
+
+void SectionWriter::addStableIds(const FunctionStableIds &ids) {
+  if (!(sections & CFG_SEC_IDS) || ids.Ids.empty()) { return; }
+
+  // one id per element of the guard array, like the distances.
+  GlobalVariable *base = nullptr;
+  uint32_t        first;
+  if (!GuardIndex(ids.Ids[0].first, base, first) ||
+      !base->getValueType()->isArrayTy()) {
+    return;
+  }
+  std::vector<Constant *> column(base->getValueType()->getArrayNumElements(),
+                                 ConstantInt::get(Int32Ty, SANCOV_CFG_NONE));
+  for (const auto &id : ids.Ids) {
+    uint32_t g;
+    if (!GuardIndex(id.first, base, g) || g >= column.size()) { return; }
+    column[g] = ConstantInt::get(Int32Ty, id.second);
+  }
+
+  std::ostringstream oss;
+  oss << "__cfg_ids_" << ids_cnt;
+  CreateChunk(*ids.Func, SANCOV_CFG_IDS, base, column.size(),
+              {{COL_U32, {ConstantInt::get(Int32Ty, ids.Name)}},
+               {COL_U32, column}},
+              oss.str(), ids_section);
+  ids_cnt++;
+}
+
+void SectionWriter::addDistances(const FunctionGuardInfo &info) {
+  if (!(sections & CFG_SEC_DIST) || !info.EntryGuard ||
+      CfgTargets::get().empty()) {
+    return;
+  }
+
+  // one distance per element of the guard array, so that cfgdump -d can
+  // fill in the guards that reach a target only through calls.
+  GlobalVariable *base = nullptr;
+  uint32_t        entry;
+  if (!GuardIndex(info.EntryGuard, base, entry) ||
+      !base->getValueType()->isArrayTy()) {
+    return;
+  }
+  std::vector<Constant *> dist(
+      base->getValueType()->getArrayNumElements(),
+      ConstantInt::get(Int32Ty, SANCOV_CFG_NONE));
+
+  std::vector<std::pair<Constant *, unsigned>> reaching;
+  ComputeTargetDistances(info, reaching);
+  for (const auto &guard : reaching) {
+    uint32_t g;
+    if (!GuardIndex(guard.first, base, g)) { return; }
+    dist[g] = ConstantInt::get(Int32Ty, guard.second);
+  }
+
+  std::ostringstream oss;
+  oss << "__cfg_dist_" << dist_cnt;
+  CreateChunk(*info.Func, SANCOV_CFG_DIST, base, dist.size(),
+              {{COL_U32, dist}}, oss.str(), dist_section);
+  dist_cnt++;
+}
+
+void SectionWriter::addFuncTable(const FunctionGuardInfo &info) {
+  if (!(sections & CFG_SEC_FUNCS) || !CfgOptions::get().funcs) { return; }
+
+  // the guard array is found from any guard, the entry block may have none.
+  Constant *any = info.EntryGuard;
+  for (unsigned i = 0; !any && i < info.BlockGuards.size(); i++) {
+    any = info.BlockGuards[i];
+  }
+  GlobalVariable *base = nullptr;
+  uint32_t        index, entry = SANCOV_CFG_NONE;
+  if (!any || !GuardIndex(any, base, index) ||
+      !base->getValueType()->isArrayTy() ||
+      (info.EntryGuard && !GuardIndex(info.EntryGuard, base, entry))) {
+    return;
+  }
+
+  // the name is a private string in the comdat of F, like its chunk. It is
+  // referenced by an offset, so that every chunk has the same size and the
+  // name needs no dynamic relocation.
+  Function          &F = *info.Func;
+  Constant          *init =
+      ConstantDataArray::getString(mod.getContext(), F.getName());
+  std::ostringstream name;
+  name << "__cfg_func_name_" << funcs_cnt;
+  GlobalVariable *str =
+      CreateGlobal(F, init->getType(), name.str(), names_section, 1);
+  str->setInitializer(init);
+
+  std::ostringstream oss;
+  oss << "__cfg_funcs_" << funcs_cnt;
+  CreateChunk(
+      F, SANCOV_CFG_FUNCS, base, 1,
+      {{COL_PTR, {FunctionRef(&F)}},
+       {COL_OFF, {str}},
+       {COL_U32,
+        {ConstantInt::get(Int32Ty,
+                          base->getValueType()->getArrayNumElements())}},
+       {COL_U32, {ConstantInt::get(Int32Ty, entry)}},
+       {COL_U32, {ConstantInt::get(Int32Ty, F.size())}}},
+      oss.str(), funcs_section);
+  funcs_cnt++;
+  NumFuncs++;
+}
+
+void SectionWriter::addIndirectCalls(const FunctionGuardInfo &info) {
+  // a function without an entry guard cannot be the target of an edge.
+  const bool target =
+      info.EntryGuard && (info.AddressTaken || info.External || info.Init);
+  if (!(sections & CFG_SEC_ICALLS) || !CfgOptions::get().icalls ||
+      (!target && info.IndirectCalls.empty())) {
+    return;
+  }
+
+  GlobalVariable         *base = nullptr;
+  uint32_t                entry = SANCOV_CFG_NONE;
+  std::vector<Constant *> guards, sigs;
+  if (info.EntryGuard && !GuardIndex(info.EntryGuard, base, entry)) { return; }
+  for (const auto &call : info.IndirectCalls) {
+    uint32_t g;
+    if (!GuardIndex(call.first, base, g)) { return; }
+    guards.push_back(ConstantInt::get(Int32Ty, g));
+    sigs.push_back(ConstantInt::get(Int32Ty, call.second));
+  }
+  const uint32_t flags = (info.AddressTaken ? SANCOV_CFG_ADDR_TAKEN : 0) |
+                         (info.External ? SANCOV_CFG_ADDR_EXTERN : 0) |
+                         (info.Init ? SANCOV_CFG_ADDR_INIT : 0);
+
+  std::ostringstream oss;
+  oss << "__cfg_icalls_" << icalls_cnt;
+  CreateChunk(*info.Func, SANCOV_CFG_ICALLS, base, guards.size(),
+              {{COL_U32, {ConstantInt::get(Int32Ty, entry)}},
+               {COL_U32, {ConstantInt::get(Int32Ty, info.Signature)}},
+               {COL_U32, {ConstantInt::get(Int32Ty, flags)}},
+               {COL_U32, guards},
+               {COL_U32, sigs}},
+              oss.str(), icalls_section);
+  icalls_cnt++;
+  NumIndirectCalls += guards.size();
+}
+
+void SectionWriter::addReturns(const FunctionGuardInfo &info) {
+  // exits matter only with an entry guard, which the calls point to.
+  const bool exits = info.EntryGuard && !info.Exits.empty();
+  if (!(sections & CFG_SEC_RETURNS) || !CfgOptions::get().returns ||
+      (!exits && info.Continuations.empty())) {
+    return;
+  }
+
+  GlobalVariable         *base = nullptr;
+  uint32_t                entry = SANCOV_CFG_NONE;
+  std::vector<Constant *> exit, call, cont;
+  if (info.EntryGuard && !GuardIndex(info.EntryGuard, base, entry)) { return; }
+  for (unsigned i = 0; exits && i < info.Exits.size(); i++) {
+    uint32_t g;
+    if (!GuardIndex(info.Exits[i], base, g)) { return; }
+    exit.push_back(ConstantInt::get(Int32Ty, g));
+  }
+  for (const auto &pair : info.Continuations) {
+    uint32_t src, dst;
+    if (!GuardIndex(pair.first, base, src) ||
+        !GuardIndex(pair.second, base, dst)) {
+      return;
+    }
+    call.push_back(ConstantInt::get(Int32Ty, src));
+    cont.push_back(ConstantInt::get(Int32Ty, dst));
+  }
+
+  std::ostringstream oss;
+  oss << "__cfg_returns_" << returns_cnt;
+  CreateChunk(*info.Func, SANCOV_CFG_RETURNS, base, exit.size(),
+              {{COL_U32, {ConstantInt::get(Int32Ty, entry)}},
+               {COL_U32, {ConstantInt::get(Int32Ty, call.size())}},
+               {COL_U32, exit},
+               {COL_U32, call},
+               {COL_U32, cont}},
+              oss.str(), returns_section);
+  returns_cnt++;
+  NumExits += exit.size();
+}
+
+void SectionWriter::addFunction(const FunctionGuardInfo &info) {
+  TimeTraceScope TimeScope("CfgWriteFunction", info.Func->getName());
+  if (format == SANCOV_CFG_VARINT) {
+    addFunctionVarint(info);
+  } else if (format != 1) {
+    addFunctionV2(info);
+  } else {
+    addFunctionV1(info);
+  }
+  addBlocks(info);
+  addDistances(info);
+  addFuncTable(info);
+  addIndirectCalls(info);
+  addReturns(info);
+}
+
+void SectionWriter::finalize() {
+  if (!Entries.empty()) {
+    std::ostringstream oss;
+    oss << "__func_entries_" << entry_cnt;
+    CreateChunk(*EntriesOwner, SANCOV_CFG_ENTRIES, nullptr, Entries.size(),
+                {{COL_PTR, Entries}, {COL_PTR, EntryGuards}}, oss.str(),
+                entry_section);
+    entry_cnt++;
+  }
+  appendToUsed(mod, ArrayRef<GlobalValue *>(Used));
+  appendToCompilerUsed(mod, ArrayRef<GlobalValue *>(CompilerUsed));
+}
+
+PreservedAnalyses llvm::WriteCfgSections(Module &M, ModuleAnalysisManager &MAM,
+                                         unsigned sections) {
+  const auto    &result = MAM.getResult<GuardAnalysis>(M);
+  TimeTraceScope TimeScope("CfgWriteSections", M.getName());
+  SectionWriter  writer(M, sections);
+  for (const auto &info : result.Functions) {
+    writer.addFunction(info);
+  }
+  writer.finalize();
+  return CfgSectionsPreserved();
+}
+
+PreservedAnalyses llvm::CfgSectionsPreserved() {
+  // the new globals, comdats and llvm.used entries change no function body,
+  // nor the guard mapping.
+  PreservedAnalyses PA;
+  PA.preserve<GuardAnalysis>();
+  PA.preserveSet<AllAnalysesOn<Function>>();
+  return PA;
+}
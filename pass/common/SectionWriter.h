@@ -0,0 +1,190 @@
+//===-- SectionWriter.h - emit cfg sections from guard info -----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Turn the result of GuardAnalysis into the global arrays read by cfgdump.
+// The layout of each record is described in api/sancov_sec.h, the format
+// (v1, v2, rel or varint) is selected by CfgOptions.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_SECTION_WRITER_H
+#define CFG_SECTION_WRITER_H
+
+#include "common/EdgeProfile.h"
+#include "common/EdgeWeights.h"
+#include "common/GuardAnalysis.h"
+#include "common/LoopStructure.h"
+#include "common/PathProfile.h"
+#include "common/StableIds.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Type.h"
+#include "llvm/TargetParser/Triple.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/** Sections emitted by a SectionWriter, may be or-ed together. */
+enum CfgSection : unsigned {
+  CFG_SEC_EDGES = 1u << 0,    // __sancov_cfg_edges
+  CFG_SEC_CALLS = 1u << 1,    // __sancov_func
+  CFG_SEC_ENTRIES = 1u << 2,  // __sancov_entries
+  CFG_SEC_BLOCKS = 1u << 3,   // __sancov_blocks, with CfgOptions::prune
+  CFG_SEC_DIST = 1u << 6,     // __sancov_dist, with CfgOptions::targets
+  CFG_SEC_FUNCS = 1u << 9,    // __sancov_funcs and __sancov_func_names,
+                              // with CfgOptions::funcs
+  CFG_SEC_ICALLS = 1u << 10,   // __sancov_icalls, with CfgOptions::icalls
+  CFG_SEC_RETURNS = 1u << 11,  // __sancov_returns, with CfgOptions::returns
+  CFG_SEC_ALL = CFG_SEC_EDGES | CFG_SEC_CALLS | CFG_SEC_ENTRIES |
+                CFG_SEC_BLOCKS | CFG_SEC_DIST | CFG_SEC_FUNCS | CFG_SEC_ICALLS |
+                CFG_SEC_RETURNS,
+  CFG_SEC_EPROF = 1u << 4,    // __sancov_eprof, by InstrumentEdgeProfile
+  CFG_SEC_PATHS = 1u << 5,    // __sancov_paths, by InstrumentPathProfile
+  CFG_SEC_WEIGHTS = 1u << 7,  // __sancov_weights, by WriteEdgeWeights
+  CFG_SEC_LOOPS = 1u << 8,    // __sancov_loops, by WriteLoopStructure
+  CFG_SEC_IDS = 1u << 12,     // __sancov_ids, by WriteStableIds
+};
+
+class SectionWriter {
+ public:
+  SectionWriter(Module &M, unsigned sections);
+
+  /** Append the records of one function. */
+  void addFunction(const FunctionGuardInfo &info);
+
+  /** Append the SANCOV_CFG_EPROF chunk of one function, in any format. */
+  void addEdgeProfile(const FunctionEdgeProfile &prof);
+
+  /** Append the SANCOV_CFG_PATHS chunk of one function, in any format. */
+  void addPathProfile(const FunctionPathProfile &prof);
+
+  /** Append the SANCOV_CFG_WEIGHTS chunk of one function, in any format. */
+  void addEdgeWeights(const FunctionEdgeWeights &weights);
+
+  /** Append the SANCOV_CFG_LOOPS chunk of one function, in any format. */
+  void addLoops(const FunctionLoops &loops);
+
+  /** Append the SANCOV_CFG_IDS chunk of one function, in any format. */
+  void addStableIds(const FunctionStableIds &ids);
+
+  /** True if the guards (nullptr skipped) all index one guard array, so
+   * that a record over them can be written. The profiles check it before
+   * instrumenting a function. */
+  bool canIndex(ArrayRef<Constant *> guards);
+
+  /** Write the shared entries chunk, retain the arrays of all functions. */
+  void finalize();
+
+ private:
+  Module           &mod;
+  const DataLayout &DL;
+  unsigned          sections;
+  unsigned          format;
+  Type             *PtrTy;
+  Type             *Int32Ty;
+  Type             *IntPtrTy;
+  Triple            TargetTriple;
+  size_t            func_cnt{0};
+  size_t            call_cnt{0};
+  size_t            entry_cnt{0};
+  size_t            blocks_cnt{0};
+  size_t            eprof_cnt{0};
+  size_t            paths_cnt{0};
+  size_t            dist_cnt{0};
+  size_t            weights_cnt{0};
+  size_t            loops_cnt{0};
+  size_t            funcs_cnt{0};
+  size_t            icalls_cnt{0};
+  size_t            returns_cnt{0};
+  size_t            ids_cnt{0};
+
+  std::vector<GlobalValue *> CompilerUsed;
+  std::vector<GlobalValue *> Used;
+
+  /** v2/rel entries of the functions without a comdat, and the first of
+   * them, written as one chunk by finalize(). */
+  std::vector<Constant *> Entries;
+  std::vector<Constant *> EntryGuards;
+  Function               *EntriesOwner{nullptr};
+
+  /** A chunk column: uint32 values, pointers to guards and functions
+   * (nullptr for NULL), the bytes of a varint stream, or int32 offsets of
+   * their target from their own address in every format. */
+  enum ColumnKind { COL_U32, COL_PTR, COL_U8, COL_OFF };
+  struct ChunkColumn {
+    ColumnKind              kind;
+    std::vector<Constant *> values;
+  };
+
+  void addFunctionV1(const FunctionGuardInfo &info);
+  void addFunctionV2(const FunctionGuardInfo &info);
+  void addFunctionVarint(const FunctionGuardInfo &info);
+  /** SANCOV_CFG_BLOCKS chunk, in any format. */
+  void addBlocks(const FunctionGuardInfo &info);
+  /** SANCOV_CFG_DIST chunk, in any format. */
+  void addDistances(const FunctionGuardInfo &info);
+  /** SANCOV_CFG_FUNCS chunk and name, in any format. */
+  void addFuncTable(const FunctionGuardInfo &info);
+  /** SANCOV_CFG_ICALLS chunk, in any format. */
+  void addIndirectCalls(const FunctionGuardInfo &info);
+  /** SANCOV_CFG_RETURNS chunk, in any format. */
+  void addReturns(const FunctionGuardInfo &info);
+
+  /** Version byte of a chunk of `kind`: v1 has no chunks, edges, calls and
+   * entries are the only packed chunks, the others fall back to v2 and rel
+   * respectively. */
+  uint8_t ChunkVersion(uint8_t kind) const;
+
+  /** rel and varint store pointers as offsets from their own address. */
+  bool RelativePointers() const;
+
+  /** Index of guard in the guard array `base`. The first guard of a function
+   * sets `base`; false if guard points into another array. */
+  bool GuardIndex(Constant *guard, GlobalVariable *&base, uint32_t &index);
+
+  /** Function as referenced from the sections: rel goes through the PLT
+   * entry of a function that may be preempted, to avoid a dynamic
+   * relocation. */
+  Constant *FunctionRef(Function *F);
+
+  /** Comdat of the records of F (the one of its guard array), nullptr on
+   * targets where the records cannot be discarded with F. */
+  Comdat *RecordComdat(Function &F);
+
+  /** Private constant without initializer, holding the records of F. It is
+   * placed in the comdat of F where supported and, on ELF, associated with
+   * F, so that the linker drops it together with F. */
+  GlobalVariable *CreateGlobal(Function &F, Type *Ty, const std::string &name,
+                               const char *section, uint64_t align);
+  GlobalVariable *CreateArray(Function &F, const std::vector<Constant *> &init,
+                              const std::string &name, const char *section);
+  /** v2/rel chunk: a chunk header with `count` followed by `columns`. */
+  GlobalVariable *CreateChunk(Function &F, uint8_t kind, Constant *guards,
+                              uint32_t count, ArrayRef<ChunkColumn> columns,
+                              const std::string &name, const char *section);
+};
+
+/** Emit `sections` for every function of M in a single walk. */
+PreservedAnalyses WriteCfgSections(Module &M, ModuleAnalysisManager &MAM,
+                                   unsigned sections);
+
+/** Analyses kept by a pass that only adds cfg section globals. */
+PreservedAnalyses CfgSectionsPreserved();
+
+}  // namespace llvm
+
+#endif  // CFG_SECTION_WRITER_H
@@ -0,0 +1,104 @@
+//===-- StableIds.cpp - guard identifiers that survive rebuilds -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The hash of a block extends the hash of its parent in the spanning tree
+// with the index of the successor leading to it, so a function is hashed in
+// linear time however deep its CFG.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/StableIds.h"
+#include "common/GuardAnalysis.h"
+#include "common/SectionWriter.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <string>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "stable-ids"
+
+STATISTIC(NumStableIds, "Guards with a stable id");
+
+static uint32_t Fold(uint64_t hash) { return (uint32_t)(hash ^ (hash >> 32)); }
+
+/** splitmix64 of the hash of the parent and the index of the successor. */
+static uint64_t ExtendPath(uint64_t parent, uint64_t succ) {
+  uint64_t z = parent + 0x9e3779b97f4a7c15ull * (succ + 1);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+/** Name of F as stable across rebuilds: local functions of different files
+ * may share a name, so their file is part of it, as in PGO. */
+static std::string StableName(const Function &F) {
+  if (!F.hasLocalLinkage()) { return F.getName().str(); }
+  const DISubprogram *SP = F.getSubprogram();
+  const StringRef     file =
+      SP ? SP->getFilename() : StringRef(F.getParent()->getSourceFileName());
+  return (file + ":" + F.getName()).str();
+}
+
+/** Fill ids with the guards of info.Func. Return false if it has none. */
+static bool HashFunction(const FunctionGuardInfo &info,
+                         FunctionStableIds       &ids) {
+  Function &F = *info.Func;
+  if (F.empty()) { return false; }
+  TimeTraceScope TimeScope("CfgStableIds", F.getName());
+
+  DenseMap<BasicBlock *, uint64_t> path;
+  std::vector<BasicBlock *>        stack;
+  BasicBlock                      *entry = &F.getEntryBlock();
+  path[entry] = ExtendPath(0, 0);
+  stack.push_back(entry);
+  while (!stack.empty()) {
+    BasicBlock *BB = stack.back();
+    stack.pop_back();
+
+    const uint64_t hash = path.lookup(BB);
+    unsigned       index = 0;
+    for (BasicBlock *succ : successors(BB)) {
+      index++;
+      if (path.count(succ)) { continue; }
+      path[succ] = ExtendPath(hash, index);
+      stack.push_back(succ);
+    }
+  }
+
+  // blocks without a guard of their own have no id, unreachable ones no
+  // position.
+  for (auto &BB : F) {
+    Constant *guard = GetSancovPcGuardArg(BB);
+    auto      it = path.find(&BB);
+    if (!guard || it == path.end()) { continue; }
+    ids.Ids.push_back(std::make_pair(guard, Fold(it->second)));
+  }
+  ids.Name = Fold(MD5Hash(StableName(F)));
+  NumStableIds += ids.Ids.size();
+  return !ids.Ids.empty();
+}
+
+PreservedAnalyses llvm::WriteStableIds(Module &M, ModuleAnalysisManager &MAM) {
+  const auto   &result = MAM.getResult<GuardAnalysis>(M);
+  SectionWriter writer(M, CFG_SEC_IDS);
+
+  for (const auto &info : result.Functions) {
+    FunctionStableIds ids;
+    ids.Func = info.Func;
+    if (HashFunction(info, ids)) { writer.addStableIds(ids); }
+  }
+  writer.finalize();
+  return CfgSectionsPreserved();
+}
@@ -0,0 +1,50 @@
+//===-- StableIds.h - guard identifiers that survive rebuilds ---*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A guard index is the position of its block in __sancov_guards, so any code
+// change renumbers the guards that follow. The stable id of a guard is the
+// hash of the name of its function (prefixed with the file for local
+// functions) and the hash of the position of its block in the CFG: the
+// successor taken at each step of the path to it in a depth-first spanning
+// tree from the entry. It does not depend on other functions, nor on the
+// instructions of the blocks, only on the shape of the CFG above the block.
+//
+// The ids go to __sancov_ids (SANCOV_CFG_IDS), and cfgdump -s prints them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_STABLE_IDS_H
+#define CFG_STABLE_IDS_H
+
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+/** Stable ids of the guards of a function. */
+struct FunctionStableIds {
+  Function *Func{nullptr};
+  /** hash of the name of the function. */
+  uint32_t Name{0};
+  /** (guard of a block, hash of the position of the block). */
+  std::vector<std::pair<Constant *, uint32_t>> Ids;
+};
+
+/** Emit the __sancov_ids chunks of the functions of M. Must run before the
+ * CFG is changed, the guard mapping is that of GuardAnalysis. */
+PreservedAnalyses WriteStableIds(Module &M, ModuleAnalysisManager &MAM);
+
+}  // namespace llvm
+
+#endif  // CFG_STABLE_IDS_H
@@ -0,0 +1,179 @@
+//===-- TargetDistance.cpp - distance of each guard to targets ------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Targets seed a breadth-first search over the reversed edges of the
+// collapsed CFG: target blocks at 0, then blocks calling a target function at
+// 1, so the queue stays sorted by distance and the first one set is final.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/TargetDistance.h"
+#include "common/Options.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "target-distance"
+
+STATISTIC(NumTargetGuards, "Guards of blocks holding a target");
+STATISTIC(NumReachingGuards, "Guards reaching a target within their function");
+
+static CfgTargets ParseTargets(const std::string &file) {
+  CfgTargets targets;
+  if (file.empty()) { return targets; }
+
+  std::ifstream in(file);
+  if (!in) {
+    std::cerr << "\033[01;31m[!]\033[0;m Cannot read CFG_TARGETS=" << file
+              << std::endl;
+    return targets;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    StringRef target = StringRef(line).trim();
+    if (target.empty() || target[0] == '#') { continue; }
+
+    // file:line if what follows the last colon is a line number, so that
+    // C++ names with :: are taken as functions.
+    const size_t colon = target.rfind(':');
+    unsigned     number;
+    if (colon != StringRef::npos && colon > 0 && target[colon - 1] != ':' &&
+        !target.substr(colon + 1).getAsInteger(10, number)) {
+      targets.Lines[number].push_back(target.substr(0, colon).str());
+    } else {
+      targets.Functions.insert(target);
+    }
+  }
+  return targets;
+}
+
+const CfgTargets &CfgTargets::get() {
+  static const CfgTargets targets = ParseTargets(CfgOptions::get().targets);
+  return targets;
+}
+
+bool CfgTargets::isTarget(const Function &F) const {
+  if (Functions.empty()) { return false; }
+  if (Functions.count(F.getName())) { return true; }
+
+  DISubprogram *SP = F.getSubprogram();
+  return SP && Functions.count(SP->getName());
+}
+
+bool CfgTargets::isTarget(StringRef path, unsigned line) const {
+  auto it = Lines.find(line);
+  if (it == Lines.end()) { return false; }
+
+  for (const auto &file : it->second) {
+    if (path.size() < file.size() ||
+        path.substr(path.size() - file.size()) != file) {
+      continue;
+    }
+    if (path.size() == file.size() ||
+        path[path.size() - file.size() - 1] == '/') {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** One of the locations of I, inlined ones included, is a target. */
+static bool HoldsTarget(const Instruction &I, const CfgTargets &targets) {
+  for (const DILocation *loc = I.getDebugLoc().get(); loc;
+       loc = loc->getInlinedAt()) {
+    StringRef file = loc->getFilename();
+    if (file.empty()) { continue; }
+    if (file[0] != '/' && !loc->getDirectory().empty()) {
+      if (targets.isTarget((loc->getDirectory() + "/" + file).str(),
+                           loc->getLine())) {
+        return true;
+      }
+    } else if (targets.isTarget(file, loc->getLine())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void llvm::ComputeTargetDistances(
+    const FunctionGuardInfo &info, std::vector<std::pair<Constant *, unsigned>> &dist) {
+  const CfgTargets &targets = CfgTargets::get();
+  Function         &F = *info.Func;
+  TimeTraceScope    TimeScope("CfgTargetDistance", F.getName());
+
+  DenseMap<Constant *, unsigned> node_of;
+  std::vector<Constant *>        guards;
+  auto node = [&](Constant *guard) {
+    auto it = node_of.insert(std::make_pair(guard, (unsigned)guards.size()));
+    if (it.second) { guards.push_back(guard); }
+    return it.first->second;
+  };
+
+  std::vector<std::pair<unsigned, unsigned>> edges;
+  for (const auto &edge : info.Edges) {
+    edges.push_back(std::make_pair(node(edge.first), node(edge.second)));
+  }
+
+  const unsigned        none = ~0u;
+  std::vector<unsigned> queue;
+  std::vector<unsigned> d;
+  auto seed = [&](unsigned n, unsigned value) {
+    if (d.size() <= n) { d.resize(guards.size(), none); }
+    if (d[n] != none) { return; }
+    d[n] = value;
+    queue.push_back(n);
+  };
+
+  if (!targets.Lines.empty()) {
+    unsigned i = 0;
+    for (auto &BB : F) {
+      Constant *guard = i < info.BlockGuards.size() ? info.BlockGuards[i] : nullptr;
+      i++;
+      if (!guard) { continue; }
+      for (auto &I : BB) {
+        if (HoldsTarget(I, targets)) {
+          seed(node(guard), 0);
+          break;
+        }
+      }
+    }
+  }
+  if (info.EntryGuard && targets.isTarget(F)) { seed(node(info.EntryGuard), 0); }
+  for (const auto &call : info.Calls) {
+    if (targets.isTarget(*call.second)) { seed(node(call.first), 1); }
+  }
+  if (queue.empty()) { return; }
+
+  d.resize(guards.size(), none);
+  std::vector<std::vector<unsigned>> preds(guards.size());
+  for (const auto &edge : edges) { preds[edge.second].push_back(edge.first); }
+  for (size_t head = 0; head < queue.size(); head++) {
+    const unsigned u = queue[head];
+    for (unsigned p : preds[u]) {
+      if (d[p] != none) { continue; }
+      d[p] = d[u] + 1;
+      queue.push_back(p);
+    }
+  }
+
+  for (unsigned n = 0; n < guards.size(); n++) {
+    if (d[n] == none) { continue; }
+    dist.push_back(std::make_pair(guards[n], d[n]));
+    if (d[n] == 0) { NumTargetGuards++; }
+    NumReachingGuards++;
+  }
+}
@@ -0,0 +1,65 @@
+//===-- TargetDistance.h - distance of each guard to targets ----*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Distance of every block to a set of targets, for directed fuzzing. The file
+// named by CFG_TARGETS lists one target per line, either `file:line`, matched
+// against the debug locations of the instructions (build with -g or
+// -gline-tables-only), or a function name, mangled or as in the source. Blank
+// lines and lines starting with `#` are ignored.
+//
+// The compiler sees one function at a time: the distance of a guard is the
+// number of edges between collapsed blocks (see GuardAnalysis) to the nearest
+// block holding a target, a call to a target function being one edge away
+// from it. The distances go to __sancov_dist (SANCOV_CFG_DIST), and
+// cfgdump -d finalizes them across calls in the linked program.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_TARGET_DISTANCE_H
+#define CFG_TARGET_DISTANCE_H
+
+#include "common/GuardAnalysis.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Function.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+struct CfgTargets {
+  /** file of the `file:line` targets, by line. */
+  std::unordered_map<unsigned, std::vector<std::string>> Lines;
+  StringSet<>                                            Functions;
+
+  bool empty() const { return Lines.empty() && Functions.empty(); }
+
+  /** F is a target, by its symbol or its name in the debug info. */
+  bool isTarget(const Function &F) const;
+
+  /** A `file:line` target is on `line` of `path`, or of a file whose path
+   * ends with it. */
+  bool isTarget(StringRef path, unsigned line) const;
+
+  /** Read from CfgOptions::targets once per process. */
+  static const CfgTargets &get();
+};
+
+/** Distance of the guards of info.Func that reach a target without leaving
+ * the function, in edges between collapsed blocks. */
+void ComputeTargetDistances(const FunctionGuardInfo                     &info,
+                            std::vector<std::pair<Constant *, unsigned>> &dist);
+
+}  // namespace llvm
+
+#endif  // CFG_TARGET_DISTANCE_H
@@ -0,0 +1,110 @@
+//===-- VirtualCalls.cpp - targets of C++ virtual calls -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// The calls guarded by a type test are found with the helpers of
+// WholeProgramDevirt (TypeMetadataUtils), which follow the vtable pointer
+// through constant offsets to the loads that feed indirect calls.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/VirtualCalls.h"
+#include "common/GuardAnalysis.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/TypeMetadataUtils.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "virtual-calls"
+
+STATISTIC(NumVirtualCalls, "Virtual calls resolved by type metadata");
+STATISTIC(NumVirtualTargets, "Candidate targets of virtual calls");
+
+VirtualTargets::VirtualTargets(Module &M) : mod(M) {
+  SmallVector<MDNode *, 2> types;
+  for (GlobalVariable &GV : M.globals()) {
+    types.clear();
+    GV.getMetadata(LLVMContext::MD_type, types);
+    if (types.empty() || !GV.hasInitializer()) { continue; }
+
+    for (MDNode *type : types) {
+      auto *offset = mdconst::dyn_extract<ConstantInt>(type->getOperand(0));
+      if (!offset) { continue; }
+      vtables[type->getOperand(1).get()].push_back(
+          std::make_pair(&GV, offset->getZExtValue()));
+    }
+  }
+}
+
+void VirtualTargets::resolve(
+    Function &F, DenseMap<const CallBase *, std::vector<Function *>> &targets)
+    const {
+  if (vtables.empty()) { return; }
+
+  std::vector<CallInst *> tests;
+  for (auto &I : instructions(F)) {
+    auto     *CI = dyn_cast<CallInst>(&I);
+    Function *Callee = CI ? CI->getCalledFunction() : nullptr;
+    if (!Callee) { continue; }
+    const StringRef name = Callee->getName();
+    if (name == "llvm.type.test" || name == "llvm.public.type.test" ||
+        StrRefStartsWith(name, "llvm.type.checked.load")) {
+      tests.push_back(CI);
+    }
+  }
+  if (tests.empty()) { return; }
+
+  DominatorTree DT(F);
+  for (CallInst *CI : tests) {
+    SmallVector<DevirtCallSite, 1> sites;
+    Value                         *type_id;
+    if (StrRefStartsWith(CI->getCalledFunction()->getName(),
+                         "llvm.type.checked.load")) {
+      SmallVector<Instruction *, 1> loads, preds;
+      bool                          non_call_uses = false;
+      findDevirtualizableCallsForTypeCheckedLoad(sites, loads, preds,
+                                                 non_call_uses, CI, DT);
+      type_id = CI->getArgOperand(2);
+    } else {
+      SmallVector<CallInst *, 1> assumes;
+      findDevirtualizableCallsForTypeTest(sites, assumes, CI, DT);
+      type_id = CI->getArgOperand(1);
+    }
+
+    auto *MAV = dyn_cast<MetadataAsValue>(type_id);
+    auto  it = MAV ? vtables.find(MAV->getMetadata()) : vtables.end();
+    if (it == vtables.end()) { continue; }
+
+    for (const DevirtCallSite &site : sites) {
+      std::vector<Function *> callees;
+      for (const auto &vtable : it->second) {
+        Constant *ptr = getPointerAtOffset(vtable.first->getInitializer(),
+                                           vtable.second + site.Offset, mod);
+        auto     *callee =
+            ptr ? dyn_cast<Function>(ptr->stripPointerCasts()) : nullptr;
+        if (callee &&
+            std::find(callees.begin(), callees.end(), callee) == callees.end()) {
+          callees.push_back(callee);
+        }
+      }
+      if (callees.empty()) { continue; }
+
+      NumVirtualCalls++;
+      NumVirtualTargets += callees.size();
+      targets[&site.CB] = std::move(callees);
+    }
+  }
+}
@@ -0,0 +1,58 @@
+//===-- VirtualCalls.h - targets of C++ virtual calls -----------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// With -fwhole-program-vtables, clang checks the vtable of each virtual call
+// with llvm.type.test (or loads the function with llvm.type.checked.load),
+// and tags every vtable with the classes it is compatible with (!type). The
+// candidate targets of a call are then the functions at its slot in each
+// vtable tagged with the class of the call, as in WholeProgramDevirt.
+//
+// GuardAnalysis records the candidates as calls of the calling block, so
+// they go to __sancov_func with the direct calls. The vtables of the whole
+// hierarchy are only in one module with full LTO (see wrapper/cc).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CFG_VIRTUAL_CALLS_H
+#define CFG_VIRTUAL_CALLS_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+class VirtualTargets {
+ public:
+  /** Index the vtables of M by type id, from their !type metadata. */
+  explicit VirtualTargets(Module &M);
+
+  /** Fill `targets` with the candidate callees of the virtual calls of F.
+   * Calls whose type test cannot be followed to the call are left out. Not
+   * thread-safe, vtable slots are read through the DataLayout. */
+  void resolve(Function                                            &F,
+               DenseMap<const CallBase *, std::vector<Function *>> &targets)
+      const;
+
+ private:
+  Module &mod;
+  /** (vtable, offset of the address point) of each type id. */
+  DenseMap<const Metadata *, std::vector<std::pair<GlobalVariable *, uint64_t>>>
+      vtables;
+};
+
+}  // namespace llvm
+
+#endif  // CFG_VIRTUAL_CALLS_H
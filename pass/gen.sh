@@ -14,9 +14,12 @@ echo "set -ex" >> $ofile
 echo CC=$CC >> $ofile
 echo CXX=\"$CXX\" >> $ofile
 echo CXXFLAGS=\"$flags\" >> $ofile
-echo $CXX $flags "../pass/cfg-edge/CfgEdgePass.cpp -g -O2 -fpic -shared -o pass/cfg-edge/cfg-edge.so" >> $ofile
-echo $CXX $flags "../pass/func-entry/FuncEntryPass.cpp -g -O2 -fpic -shared -o pass/func-entry/func-entry.so" >> $ofile
-echo $CXX $flags "../pass/func-call/FuncCallPass.cpp -g -O2 -fpic -shared -o pass/func-call/func-call.so" >> $ofile
+common="-I.. -I../pass ../pass/common/CoverageFilter.cpp ../pass/common/EdgeProfile.cpp ../pass/common/EdgeWeights.cpp ../pass/common/GuardAnalysis.cpp ../pass/common/LoopStructure.cpp ../pass/common/Options.cpp ../pass/common/PathProfile.cpp ../pass/common/ProfileCounters.cpp ../pass/common/SectionWriter.cpp ../pass/common/StableIds.cpp ../pass/common/TargetDistance.cpp ../pass/common/VirtualCalls.cpp"
+echo $CXX $flags "../pass/cfg-all/CfgAllPass.cpp $common -g -O2 -fpic -shared -o pass/cfg-all/cfg-all.so" >> $ofile
+echo $CXX $flags "../pass/cfg-edge/CfgEdgePass.cpp $common -g -O2 -fpic -shared -o pass/cfg-edge/cfg-edge.so" >> $ofile
+echo $CXX $flags "../pass/cfg-path/CfgPathPass.cpp $common -g -O2 -fpic -shared -o pass/cfg-path/cfg-path.so" >> $ofile
+echo $CXX $flags "../pass/func-entry/FuncEntryPass.cpp $common -g -O2 -fpic -shared -o pass/func-entry/func-entry.so" >> $ofile
+echo $CXX $flags "../pass/func-call/FuncCallPass.cpp $common -g -O2 -fpic -shared -o pass/func-call/func-call.so" >> $ofile
 echo $CXX $flags "../pass/null-malloc/NullMallocPass.cpp -g -O2 -fpic -shared -o pass/null-malloc/null-malloc.so" >> $ofile
 
 chmod +x $ofile
@@ -14,6 +14,7 @@
 #include "llvm/Transforms/Instrumentation/SanitizerCoverage.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/PostDominators.h"
 #include "llvm/Config/llvm-config.h"
@@ -40,6 +41,7 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/SpecialCaseList.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/VirtualFileSystem.h"
 #include "llvm/TargetParser/Triple.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -74,6 +76,11 @@ namespace llvm {
 
 using namespace llvm;
 
+#define DEBUG_TYPE "null-malloc"
+
+STATISTIC(NumReplaced, "Allocator calls redirected to cfg_*");
+STATISTIC(NumIndirectCalls, "Indirect calls skipped");
+
 PreservedAnalyses
 NullMallocPass::run(Module &mod, ModuleAnalysisManager &MAM) {
   PtrTy = PointerType::get(Type::getVoidTy(mod.getContext()), 0);
@@ -104,18 +111,22 @@ NullMallocPass::run(Module &mod, ModuleAnalysisManager &MAM) {
   nullFunctions["reallocarray"] = cfgReallocArr;
 
   for (Function &f : mod) {
+    TimeTraceScope TimeScope("NullMallocFunction", f.getName());
     for (BasicBlock &bb : f) {
       for (Instruction &i : bb) {
         if (CallBase *cb = dyn_cast<CallBase>(&i)) {
           Function *Callee = cb->getCalledFunction();
-          if (!Callee)
+          if (!Callee) {
+            NumIndirectCalls++;
             continue;
+          }
           const std::string calleeName = Callee->getName().str();
           auto ptr = nullFunctions.find(calleeName);
           if (ptr != nullFunctions.end()) {
             Function *fobj = dyn_cast<Function>(ptr->second);
             assert(fobj && "fobj is not a fuction");
             cb->setCalledFunction(fobj);
+            NumReplaced++;
           }
         }
       }
@@ -1,7 +1,41 @@
 // Take an ELF file instrumented with
 // -fsanitize-coverage=trace-pc-guard,pc-table(,no-prune), recover its control
 // flow graph, including intra-function control-flow and inter-function
-// call.
+// call. Blocks are numbered by their guard, or by their element of
+// __sancov_cntrs (inline-8bit-counters) or __sancov_bools (inline-bool-flag).
+//
+// Sections in v1, v2, rel and varint format (see api/sancov_sec.h) are
+// accepted, the format is detected from the content of each section. Sections
+// are read through a bounded window and decoded chunk by chunk.
+//
+// A binary stripped with tools/cfgsplit.sh has no cfg sections, they are read
+// from the sidecar file named after its build-id instead.
+//
+// With pruned instrumentation (CFG_PRUNE=1), -b prints the block-level graph
+// rebuilt from __sancov_blocks, and -c infers the blocks covered by a run
+// from the guards it hit.
+//
+// With edge profiling (CFG_EDGE_PROF=1), -p rebuilds the count of every edge
+// from the counters dumped by a run and the spanning trees in __sancov_eprof.
+// With path profiling (CFG_PATHS=1), -P prints the paths run and their count
+// from the path ids numbered in __sancov_paths.
+//
+// With CFG_WEIGHTS=1, -w prints the branch probability and frequency of each
+// edge from __sancov_weights. With CFG_LOOPS=1, -l prints the loops of
+// __sancov_loops. With CFG_STABLE_IDS=1, -s prints the id of each guard that
+// survives rebuilds from __sancov_ids.
+//
+// With CFG_FUNCS=1, -f prints the function table of __sancov_funcs, and -F
+// slices the graph to the edges out of one function, found in it without the
+// symbol table. -u (which also needs CFG_ICALLS=1) prints the functions the
+// graph cannot reach from main or the fuzz entry points, as a list a later
+// build takes in CFG_UNREACHABLE.
+//
+// With CFG_ICALLS=1, -i and -I add the indirect calls of __sancov_icalls.
+// With CFG_RETURNS=1, -r and -R add the returns of __sancov_returns.
+//
+// For directed fuzzing (CFG_TARGETS), -d finalizes the distances to the
+// targets in __sancov_dist of the input file across calls, once linked.
 
 extern "C" {
 #include <elf.h>
@@ -16,11 +50,44 @@ extern "C" {
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <queue>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
-static const char *usage = "Usage: cfg <input file>\n";
+static const char *usage =
+    "Usage: cfg [-b] [-c covered guards] [-d] [-f] [-F function] [-i] [-I] "
+    "[-l] [-p counters] [-P counters] [-r] [-R] [-s] [-u] [-w] <input file> "
+    "[sidecar dir]\n"
+    "  -b  print the block-level graph of pruned functions\n"
+    "  -c  print the blocks covered by a run, read the indices of the guards\n"
+    "      it hit from a file\n"
+    "  -d  write the distance of every block to the nearest target, through\n"
+    "      calls, into __sancov_dist of the input file (CFG_TARGETS)\n"
+    "  -f  print the guard range [first, last), entry guard, block count and\n"
+    "      name of each function (CFG_FUNCS=1)\n"
+    "  -F  print only the edges out of a function, named by its symbol or by\n"
+    "      one of its guards\n"
+    "  -i  add an edge from each indirect call to the entry of every function\n"
+    "      of the same signature whose address is taken (CFG_ICALLS=1)\n"
+    "  -I  as -i, also to the functions other modules may take the address of\n"
+    "  -l  print the header, depth, parent header and latches of each loop\n"
+    "  -p  print the count of each edge of the profiled functions, read the\n"
+    "      counters of a run from a file (cfg.eprof)\n"
+    "  -P  print the count and guards of each path run by the profiled\n"
+    "      functions, read the counters of a run from a file (cfg.paths)\n"
+    "  -r  add an edge from each exit of a called function back to the\n"
+    "      calling block or the continuation of an invoke (CFG_RETURNS=1)\n"
+    "  -R  print the valid-path graph: calls are labeled (site and returns\n"
+    "      )site, site being the guard of the calling block (CFG_RETURNS=1)\n"
+    "  -s  print the stable id of each guard, which names its block across\n"
+    "      rebuilds (CFG_STABLE_IDS=1)\n"
+    "  -u  print the functions unreachable from main and the libFuzzer entry\n"
+    "      points, as a list for CFG_UNREACHABLE (CFG_FUNCS=1 CFG_ICALLS=1)\n"
+    "  -w  print the probability and runs per call of each edge\n";
 
 static void *xmalloc(size_t size) {
   void *ptr = malloc(size);
@@ -101,6 +168,19 @@ struct ElfFile {
     return true;
   }
 
+  void read_at(void *dst, off_t offset, size_t count) {
+    xreadat(dst, offset, count);
+  }
+
+  bool read_section(const char *name, std::vector<uint8_t> &data) {
+    Elf64_Shdr *shdr = get_section_hdr(name);
+    if (!shdr) { return false; }
+
+    data.resize(shdr->sh_size);
+    if (shdr->sh_size != 0) { xreadat(data.data(), shdr->sh_offset, shdr->sh_size); }
+    return true;
+  }
+
  private:
   int         fd{-1};
   Elf64_Ehdr  ehdr;
@@ -123,157 +203,1518 @@ struct ElfFile {
   }
 };
 
+static const char *hint =
+    "compile the program with -fsanitize-coverage=trace-pc-guard,pc-table "
+    "(or inline-8bit-counters, inline-bool-flag) to generate this section.\n";
+
+/** Arrays a block can be numbered against, in order of preference: a 4-byte
+ * guard, or a 1-byte counter or flag. */
+static const struct {
+  const char *name;
+  size_t      elem;
+} guard_sections[] = {
+    {"__sancov_guards", sizeof(uint32_t)},
+    {"__sancov_cntrs", sizeof(uint8_t)},
+    {"__sancov_bools", sizeof(uint8_t)},
+};
+
+/** Maps guard (counter, flag) addresses to their index in their section. */
+struct GuardSpace {
+  uintptr_t start{0};
+  uintptr_t end{0};
+  size_t    elem{sizeof(uint32_t)};
+
+  bool contains(uintptr_t guard) const {
+    return guard >= start && guard < end;
+  }
+
+  uint64_t index(uintptr_t guard) const { return (guard - start) / elem; }
+
+  uint64_t size() const { return (end - start) / elem; }
+
+  /** index of the guard `idx` elements after `base`, exit if out of range. */
+  uint64_t checked_index(uintptr_t base, uint64_t idx,
+                         const char *section) const {
+    const uintptr_t guard = base + idx * elem;
+    if (!contains(guard)) {
+      fprintf(stderr, "Invalid guard in section %s\n%s", section, hint);
+      exit(1);
+    }
+    return index(guard);
+  }
+};
+
+typedef std::pair<uint64_t, uint64_t> Edge;
+
+/** Path of the sidecar written by tools/cfgsplit.sh for the build-id of
+ * elf_obj: <dir>/.build-id/xx/yyyy.cfg, as gdb does for debug files. */
+static bool sidecar_path(ElfFile &elf_obj, const std::string &dir,
+                         std::string &path) {
+  std::vector<uint8_t> note;
+  if (!elf_obj.read_section(".note.gnu.build-id", note)) { return false; }
+
+  Elf64_Nhdr nhdr;
+  if (note.size() < sizeof(nhdr)) { return false; }
+  memcpy(&nhdr, note.data(), sizeof(nhdr));
+
+  const size_t desc = sizeof(nhdr) + ((nhdr.n_namesz + 3) & ~3u);
+  if (nhdr.n_type != NT_GNU_BUILD_ID || nhdr.n_descsz < 2 ||
+      desc + nhdr.n_descsz > note.size()) {
+    return false;
+  }
+
+  static const char digits[] = "0123456789abcdef";
+  path = dir + "/.build-id/";
+  for (size_t i = 0; i < nhdr.n_descsz; i++) {
+    if (i == 1) { path += '/'; }
+    path += digits[note[desc + i] >> 4];
+    path += digits[note[desc + i] & 0xf];
+  }
+  path += ".cfg";
+  return true;
+}
+
+static uintptr_t load_ptr(const uint8_t *data) {
+  uintptr_t ptr;
+  memcpy(&ptr, data, sizeof(ptr));
+  return ptr;
+}
+
+static uint32_t load_u32(const uint8_t *data) {
+  uint32_t val;
+  memcpy(&val, data, sizeof(val));
+  return val;
+}
+
+/** Bytes of a section read at once. */
+static const size_t window_size = 1 << 20;
+
+/** A section read through a bounded window, so that huge sections are never
+ * held in memory as a whole. */
+class SectionStream {
+ public:
+  const char *name{nullptr};
+  uintptr_t   addr{0};  // address at run time
+  size_t      size{0};
+
+  void open(ElfFile &elf_obj, const char *section) {
+    Elf64_Shdr *shdr = elf_obj.get_section_hdr(section);
+    if (!shdr) {
+      fprintf(stderr, "Cannot read section %s\n%s", section, hint);
+      exit(1);
+    }
+    elf = &elf_obj;
+    name = section;
+    addr = shdr->sh_addr;
+    size = shdr->sh_size;
+    file_off = shdr->sh_offset;
+  }
+
+  /** Bytes [off, off + n) of the section, valid until the next call. */
+  const uint8_t *peek(size_t off, size_t n) {
+    assert(off + n <= size);
+    if (off < window_off || off + n > window_off + window.size()) {
+      const size_t len = std::min(size - off, std::max(n, window_size));
+      window.resize(len);
+      elf->read_at(window.data(), file_off + off, len);
+      window_off = off;
+    }
+    return &window[off - window_off];
+  }
+
+ private:
+  ElfFile             *elf{nullptr};
+  size_t               file_off{0};
+  size_t               window_off{0};
+  std::vector<uint8_t> window;
+};
+
+/** v2, rel and varint sections start with a chunk header, v1 sections with a
+ * pointer. */
+static bool is_v2_section(SectionStream &sec) {
+  SancovCfgHeader hdr;
+  if (sec.size < sizeof(hdr)) { return false; }
+
+  memcpy(&hdr, sec.peek(0, sizeof(hdr)), sizeof(hdr));
+  return sancov_cfg_is_header(&hdr);
+}
+
+/** Call fn(record) for each fixed-size record of a v1 section. */
+template <typename Fn>
+static void for_each_record(SectionStream &sec, size_t record, Fn fn) {
+  for (size_t i = 0; i + record <= sec.size; i += record) {
+    fn(sec.peek(i, record));
+  }
+}
+
+/** Cursor over the LEB128 stream of a varint chunk. */
+struct VarintStream {
+  const uint8_t *cur;
+  const uint8_t *end;
+  const char    *section;
+
+  uint64_t next() {
+    uint64_t value;
+    if (!sancov_cfg_uleb128(&cur, end, &value)) {
+      fprintf(stderr, "Truncated varint stream in section %s\n", section);
+      exit(1);
+    }
+    return value;
+  }
+};
+
+/** A v2, rel or varint chunk, addressed by offsets from its header. */
+struct Chunk {
+  const uint8_t  *bytes;
+  uintptr_t       addr;  // address of the chunk at run time
+  SancovCfgHeader hdr;
+
+  /** offset of the first column. */
+  size_t payload() const { return sancov_cfg_header_size(&hdr); }
+
+  size_t ptr_size() const { return sancov_cfg_ptr_size(&hdr); }
+
+  uint32_t u32_at(size_t at) const { return load_u32(bytes + at); }
+
+  /** Pointer stored at offset `at`, rel and varint pointers are relative to
+   * their own address. */
+  uintptr_t ptr_at(size_t at) const {
+    if (hdr.version == SANCOV_CFG_V2) { return load_ptr(bytes + at); }
+
+    const int32_t rel = (int32_t)load_u32(bytes + at);
+    return rel ? addr + at + rel : 0;
+  }
+
+  /** Address of the target of the int32 offset at `at`, in any version. */
+  uintptr_t off_at(size_t at) const {
+    return addr + at + (int32_t)load_u32(bytes + at);
+  }
+
+  uintptr_t guards() const { return ptr_at(sizeof(SancovCfgHeader)); }
+
+  /** varint: the stream follows the pointer column, if any. */
+  VarintStream stream(const char *section) const {
+    SancovCfgHeaderVarint full;
+    memcpy(&full, bytes, sizeof(full));
+    size_t off = payload();
+    if (hdr.kind != SANCOV_CFG_EDGES) { off += ptr_size() * hdr.count; }
+    return VarintStream{bytes + off, bytes + off + full.size, section};
+  }
+};
+
+/** Call fn(chunk) for each chunk of `kind` in a v2/rel/varint section. */
+template <typename Fn>
+static void for_each_chunk(SectionStream &sec, uint8_t kind, Fn fn) {
+  size_t off = 0;
+  while (off + sizeof(uint32_t) <= sec.size) {
+    if (load_u32(sec.peek(off, sizeof(uint32_t))) == 0) {
+      // padding inserted by the linker.
+      off += sizeof(uint32_t);
+      continue;
+    }
+
+    Chunk chunk;
+    if (off + sizeof(SancovCfgHeader) <= sec.size) {
+      memcpy(&chunk.hdr, sec.peek(off, sizeof(chunk.hdr)), sizeof(chunk.hdr));
+    }
+    if (off + sizeof(SancovCfgHeader) > sec.size ||
+        !sancov_cfg_is_header(&chunk.hdr)) {
+      fprintf(stderr,
+              "Invalid chunk in section %s, "
+              "are v1 and v2 objects linked together?\n",
+              sec.name);
+      exit(1);
+    }
+
+    // the size of a chunk is known from its header, and from end[] (stored
+    // after the callees) for v2/rel calls, end[] and call_end[] for blocks,
+    // end[] for loops, conts[] for returns.
+    size_t fixed = sancov_cfg_header_size(&chunk.hdr);
+    if (chunk.hdr.kind == SANCOV_CFG_CALLS &&
+        chunk.hdr.version != SANCOV_CFG_VARINT) {
+      fixed += (chunk.ptr_size() + 4) * (size_t)chunk.hdr.count;
+    } else if (chunk.hdr.kind == SANCOV_CFG_BLOCKS) {
+      fixed += 5 * 4 * (size_t)chunk.hdr.count;
+    } else if (chunk.hdr.kind == SANCOV_CFG_EPROF) {
+      fixed += chunk.ptr_size() + 4;
+    } else if (chunk.hdr.kind == SANCOV_CFG_LOOPS) {
+      fixed += 4 * 4 * (size_t)chunk.hdr.count;
+    } else if (chunk.hdr.kind == SANCOV_CFG_RETURNS) {
+      fixed += 2 * 4;
+    }
+    const size_t size =
+        off + fixed <= sec.size
+            ? sancov_cfg_chunk_size((const SancovCfgHeader *)sec.peek(off, fixed))
+            : fixed;
+    if (off + size > sec.size) {
+      fprintf(stderr, "Truncated chunk in section %s\n", sec.name);
+      exit(1);
+    }
+    if (chunk.hdr.kind == kind) {
+      chunk.bytes = sec.peek(off, size);
+      chunk.addr = sec.addr + off;
+      fn(chunk);
+    }
+    off += size;
+  }
+}
+
+/** Load intra control-flow, ie. edges between basic blocks
+ *  inside a function.
+ */
+static void load_edges(ElfFile &elf_obj, const GuardSpace &guards,
+                       std::vector<Edge> &edge_list) {
+  const char   *section = "__sancov_cfg_edges";
+  SectionStream sec;
+  sec.open(elf_obj, section);
+
+  if (is_v2_section(sec)) {
+    for_each_chunk(sec, SANCOV_CFG_EDGES, [&](const Chunk &chunk) {
+      const uintptr_t base = chunk.guards();
+      if (chunk.hdr.version == SANCOV_CFG_VARINT) {
+        VarintStream in = chunk.stream(section);
+        uint64_t     src = 0;
+        for (size_t i = 0; i < chunk.hdr.count; i++) {
+          src += in.next();
+          const uint64_t dst = src + sancov_cfg_unzigzag(in.next());
+          edge_list.push_back(Edge(guards.checked_index(base, src, section),
+                                   guards.checked_index(base, dst, section)));
+        }
+        return;
+      }
+
+      const size_t src = chunk.payload();
+      const size_t dst = src + 4 * (size_t)chunk.hdr.count;
+      for (size_t i = 0; i < chunk.hdr.count; i++) {
+        edge_list.push_back(
+            Edge(guards.checked_index(base, chunk.u32_at(src + 4 * i), section),
+                 guards.checked_index(base, chunk.u32_at(dst + 4 * i),
+                                      section)));
+      }
+    });
+    return;
+  }
+
+  for_each_record(sec, sizeof(SancovCfgEdge), [&](const uint8_t *record) {
+    const uintptr_t src = load_ptr(record);
+    const uintptr_t dst = load_ptr(record + sizeof(void *));
+    if (!src || !dst) {
+      // Skip edges with null src or dst.
+      return;
+    }
+    edge_list.push_back(Edge(guards.checked_index(src, 0, section),
+                             guards.checked_index(dst, 0, section)));
+  });
+}
+
+/** Load the guard to the entry block of each function.*/
+static void load_entries(ElfFile &elf_obj, const GuardSpace &guards,
+                         std::unordered_map<uintptr_t, uint64_t> &entries) {
+  const char   *section = "__sancov_entries";
+  SectionStream sec;
+  sec.open(elf_obj, section);
+
+  if (is_v2_section(sec)) {
+    for_each_chunk(sec, SANCOV_CFG_ENTRIES, [&](const Chunk &chunk) {
+      const size_t n = chunk.hdr.count;
+      const size_t ptr = chunk.ptr_size();
+      const size_t func = chunk.payload();
+      if (chunk.hdr.version == SANCOV_CFG_VARINT) {
+        const uintptr_t base = chunk.guards();
+        VarintStream    in = chunk.stream(section);
+        for (size_t i = 0; i < n; i++) {
+          const uintptr_t f = chunk.ptr_at(func + ptr * i);
+          const uint64_t  entry = in.next();
+          if (f) { entries[f] = guards.checked_index(base, entry, section); }
+        }
+        return;
+      }
+
+      const size_t guard = func + ptr * n;
+      for (size_t i = 0; i < n; i++) {
+        const uintptr_t f = chunk.ptr_at(func + ptr * i);
+        const uintptr_t entry = chunk.ptr_at(guard + ptr * i);
+        if (f && entry) { entries[f] = guards.checked_index(entry, 0, section); }
+      }
+    });
+    return;
+  }
+
+  for_each_record(sec, sizeof(SancovEntry), [&](const uint8_t *record) {
+    const uintptr_t func = load_ptr(record);
+    const uintptr_t entry = load_ptr(record + sizeof(void *));
+    if (func && entry) {
+      entries[func] = guards.checked_index(entry, 0, section);
+    }
+  });
+}
+
+/** Stitch inter-function control flow graph. */
+static void load_calls(ElfFile &elf_obj, const GuardSpace &guards,
+                       const std::unordered_map<uintptr_t, uint64_t> &entries,
+                       std::vector<Edge> &edge_list) {
+  const char   *section = "__sancov_func";
+  SectionStream sec;
+  sec.open(elf_obj, section);
+
+  auto add_call = [&](uint64_t guard, uintptr_t func) {
+    auto ptr = entries.find(func);
+    if (ptr != entries.end()) { edge_list.push_back(Edge(guard, ptr->second)); }
+  };
+
+  if (is_v2_section(sec)) {
+    for_each_chunk(sec, SANCOV_CFG_CALLS, [&](const Chunk &chunk) {
+      const uintptr_t base = chunk.guards();
+      const size_t    n = chunk.hdr.count;
+      const size_t    callee = chunk.payload();
+      if (chunk.hdr.version == SANCOV_CFG_VARINT) {
+        VarintStream in = chunk.stream(section);
+        for (size_t i = 0; i < n; i++) {
+          const uintptr_t func = chunk.ptr_at(callee + chunk.ptr_size() * i);
+          auto            ptr = entries.find(func);
+          const uint64_t  calls = in.next();
+          uint64_t        guard = 0;
+          for (uint64_t j = 0; j < calls; j++) {
+            guard += in.next();
+            if (func && ptr != entries.end()) {
+              edge_list.push_back(
+                  Edge(guards.checked_index(base, guard, section),
+                       ptr->second));
+            }
+          }
+        }
+        return;
+      }
+
+      const size_t end = callee + chunk.ptr_size() * n;
+      const size_t guard = end + 4 * n;
+
+      // CSR: callee i is called from guards [end[i-1], end[i]).
+      uint32_t begin = 0;
+      for (size_t i = 0; i < n; i++) {
+        const uintptr_t func = chunk.ptr_at(callee + chunk.ptr_size() * i);
+        const uint32_t  stop = chunk.u32_at(end + 4 * i);
+        auto            ptr = entries.find(func);
+        if (stop < begin) {
+          fprintf(stderr, "Invalid call offsets in section %s\n", section);
+          exit(1);
+        }
+        if (func && ptr != entries.end()) {
+          for (uint32_t j = begin; j < stop; j++) {
+            edge_list.push_back(
+                Edge(guards.checked_index(base, chunk.u32_at(guard + 4 * j),
+                                          section),
+                     ptr->second));
+          }
+        }
+        begin = stop;
+      }
+    });
+    return;
+  }
+
+  for_each_record(sec, sizeof(SancovFuncCall), [&](const uint8_t *record) {
+    const uintptr_t guard = load_ptr(record);
+    const uintptr_t func = load_ptr(record + sizeof(void *));
+    if (func && guard) { add_call(guards.checked_index(guard, 0, section), func); }
+  });
+}
+
+/** Resolve indirect calls by signature: an edge from each indirect call site
+ * to the entry of every function of the called signature with one of `flags`
+ * (SANCOV_CFG_ADDR_TAKEN, SANCOV_CFG_ADDR_EXTERN). */
+static void load_icalls(ElfFile &cfg_obj, const GuardSpace &guards,
+                        uint32_t flags, std::vector<Edge> &edge_list) {
+  const char   *section = "__sancov_icalls";
+  SectionStream sec;
+  sec.open(cfg_obj, section);
+
+  std::unordered_multimap<uint32_t, uint64_t> targets;
+  std::vector<std::pair<uint64_t, uint32_t>>  sites;
+  for_each_chunk(sec, SANCOV_CFG_ICALLS, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    const size_t    n = chunk.hdr.count;
+    const size_t    entry = chunk.payload();
+    const size_t    guard = entry + 3 * 4;
+    const size_t    sig = guard + 4 * n;
+    const uint32_t  head = chunk.u32_at(entry);
+    if (head != SANCOV_CFG_NONE && (chunk.u32_at(entry + 8) & flags)) {
+      targets.emplace(chunk.u32_at(entry + 4),
+                      guards.checked_index(base, head, section));
+    }
+    for (size_t i = 0; i < n; i++) {
+      sites.push_back(std::make_pair(
+          guards.checked_index(base, chunk.u32_at(guard + 4 * i), section),
+          chunk.u32_at(sig + 4 * i)));
+    }
+  });
+
+  for (const auto &site : sites) {
+    auto range = targets.equal_range(site.second);
+    for (auto it = range.first; it != range.second; ++it) {
+      edge_list.push_back(Edge(site.first, it->second));
+    }
+  }
+}
+
+/** A return edge (exit of the callee, block the call returns to) and the
+ * guard of the calling block. */
+typedef std::pair<Edge, uint64_t> Return;
+
+/** Return edges of the calls in call_list: from each exit of the callee,
+ * known by its entry guard, to the calling block and to the continuation of
+ * the invoke ending it, see SANCOV_CFG_RETURNS. */
+static void load_returns(ElfFile &cfg_obj, const GuardSpace &guards,
+                         const std::vector<Edge> &call_list,
+                         std::vector<Return>     &return_list) {
+  const char   *section = "__sancov_returns";
+  SectionStream sec;
+  sec.open(cfg_obj, section);
+
+  std::unordered_map<uint64_t, std::vector<uint64_t>> exits;
+  std::unordered_multimap<uint64_t, uint64_t>          conts;
+  for_each_chunk(sec, SANCOV_CFG_RETURNS, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    const size_t    n = chunk.hdr.count;
+    const size_t    entry = chunk.payload();
+    const uint32_t  m = chunk.u32_at(entry + 4);
+    const size_t    exit = entry + 2 * 4;
+    const size_t    call = exit + 4 * n;
+    const size_t    cont = call + 4 * (size_t)m;
+    auto guard = [&](size_t at) {
+      return guards.checked_index(base, chunk.u32_at(at), section);
+    };
+
+    if (chunk.u32_at(entry) != SANCOV_CFG_NONE) {
+      auto &list = exits[guard(entry)];
+      for (size_t i = 0; i < n; i++) { list.push_back(guard(exit + 4 * i)); }
+    }
+    for (size_t i = 0; i < m; i++) {
+      conts.emplace(guard(call + 4 * i), guard(cont + 4 * i));
+    }
+  });
+
+  for (const auto &call : call_list) {
+    auto it = exits.find(call.second);
+    if (it == exits.end()) { continue; }
+    auto range = conts.equal_range(call.first);
+    for (uint64_t exit : it->second) {
+      return_list.push_back(Return(Edge(exit, call.first), call.first));
+      for (auto cont = range.first; cont != range.second; ++cont) {
+        return_list.push_back(Return(Edge(exit, cont->second), call.first));
+      }
+    }
+  }
+}
+
+/** Blocks of the functions with pruned blocks, see SANCOV_CFG_BLOCKS. A block
+ * with a guard is named by the index of its guard, the others by numbers
+ * following the last guard, in section order. */
+struct BlockGraph {
+  static const uint64_t none = ~(uint64_t)0;
+
+  std::vector<uint64_t>        node;     // name of each block
+  std::vector<bool>            guarded;  // has a guard of its own
+  std::vector<uint64_t>        idom;     // block index, or none
+  std::vector<uint64_t>        ipdom;    // block index, or none
+  std::vector<Edge>            succs;    // (block index, block index)
+  std::vector<std::pair<uint64_t, uintptr_t>> calls;  // (block index, callee)
+  std::unordered_set<uint64_t> guards;  // guards of these functions
+};
+
+static void load_blocks(ElfFile &elf_obj, const GuardSpace &guards,
+                        BlockGraph &graph) {
+  const char *section = "__sancov_blocks";
+  if (!elf_obj.get_section_hdr(section)) {
+    // built with no-prune, every block has a guard.
+    return;
+  }
+  SectionStream sec;
+  sec.open(elf_obj, section);
+
+  uint64_t next = guards.size();
+  for_each_chunk(sec, SANCOV_CFG_BLOCKS, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    const size_t    n = chunk.hdr.count;
+    const size_t    guard = chunk.payload();
+    const size_t    idom = guard + 4 * n;
+    const size_t    ipdom = idom + 4 * n;
+    const size_t    end = ipdom + 4 * n;
+    const size_t    call_end = end + 4 * n;
+    const size_t    succ = call_end + 4 * n;
+    const size_t    callee =
+        sancov_cfg_blocks_callees((const SancovCfgHeader *)chunk.bytes);
+    const uint64_t  first = graph.node.size();
+
+    auto block = [&](uint32_t index) -> uint64_t {
+      if (index == SANCOV_CFG_NONE) { return BlockGraph::none; }
+      if (index >= n) {
+        fprintf(stderr, "Invalid block in section %s\n", section);
+        exit(1);
+      }
+      return first + index;
+    };
+
+    uint32_t begin = 0, call_begin = 0;
+    for (size_t i = 0; i < n; i++) {
+      const uint32_t g = chunk.u32_at(guard + 4 * i);
+      if (g == SANCOV_CFG_NONE) {
+        graph.node.push_back(next++);
+        graph.guarded.push_back(false);
+      } else {
+        graph.node.push_back(guards.checked_index(base, g, section));
+        graph.guarded.push_back(true);
+        graph.guards.insert(graph.node.back());
+      }
+      graph.idom.push_back(block(chunk.u32_at(idom + 4 * i)));
+      graph.ipdom.push_back(block(chunk.u32_at(ipdom + 4 * i)));
+
+      const uint32_t stop = chunk.u32_at(end + 4 * i);
+      if (stop < begin) {
+        fprintf(stderr, "Invalid successor offsets in section %s\n", section);
+        exit(1);
+      }
+      for (uint32_t j = begin; j < stop; j++) {
+        const uint64_t dst = block(chunk.u32_at(succ + 4 * j));
+        if (dst == BlockGraph::none) {
+          fprintf(stderr, "Invalid block in section %s\n", section);
+          exit(1);
+        }
+        graph.succs.push_back(Edge(first + i, dst));
+      }
+      begin = stop;
+
+      const uint32_t call_stop = chunk.u32_at(call_end + 4 * i);
+      if (call_stop < call_begin) {
+        fprintf(stderr, "Invalid call offsets in section %s\n", section);
+        exit(1);
+      }
+      for (uint32_t j = call_begin; j < call_stop; j++) {
+        const uintptr_t func = chunk.ptr_at(callee + chunk.ptr_size() * j);
+        if (func) { graph.calls.push_back(std::make_pair(first + i, func)); }
+      }
+      call_begin = call_stop;
+    }
+  });
+}
+
+/** Replace the edges leaving the guards of pruned functions, jumps and calls,
+ * with the edges leaving their blocks. */
+static void expand_blocks(
+    const BlockGraph                              &graph,
+    const std::unordered_map<uintptr_t, uint64_t> &entries,
+    std::vector<Edge>                             &edges) {
+  edges.erase(std::remove_if(edges.begin(), edges.end(),
+                             [&](const Edge &edge) {
+                               return graph.guards.count(edge.first) != 0;
+                             }),
+              edges.end());
+  for (const auto &succ : graph.succs) {
+    edges.push_back(Edge(graph.node[succ.first], graph.node[succ.second]));
+  }
+  for (const auto &call : graph.calls) {
+    auto ptr = entries.find(call.second);
+    if (ptr != entries.end()) {
+      edges.push_back(Edge(graph.node[call.first], ptr->second));
+    }
+  }
+}
+
+/** Blocks covered by a run that hit the guards in `covered`: a block without
+ * a guard ran if it dominates a block that ran, or post-dominates one (as
+ * sancov assumes when it prunes, a function is left through an exit). A
+ * post-dominator whose guard was not hit stops the inference. */
+static void infer_coverage(const BlockGraph      &graph,
+                           std::vector<uint64_t> &covered) {
+  std::unordered_set<uint64_t> hit(covered.begin(), covered.end());
+  std::vector<bool>            ran(graph.node.size(), false);
+  std::vector<uint64_t>        work;
+  for (uint64_t b = 0; b < graph.node.size(); b++) {
+    if (graph.guarded[b] && hit.count(graph.node[b])) {
+      ran[b] = true;
+      work.push_back(b);
+    }
+  }
+
+  while (!work.empty()) {
+    const uint64_t b = work.back();
+    work.pop_back();
+    for (uint64_t parent : {graph.idom[b], graph.ipdom[b]}) {
+      if (parent != BlockGraph::none && !graph.guarded[parent] &&
+          !ran[parent]) {
+        ran[parent] = true;
+        covered.push_back(graph.node[parent]);
+        work.push_back(parent);
+      }
+    }
+  }
+}
+
+/** Counters written by wrapper/cfgprof.c: the raw contents of a counter
+ * section (__sancov_eprof_cntrs, __sancov_path_cntrs) at exit. */
+struct CounterDump {
+  uintptr_t             start{0};  // address of the section at run time
+  uintptr_t             end{0};
+  std::vector<uint64_t> values;
+
+  void open(ElfFile &elf_obj, const char *section, const char *env,
+            const char *path) {
+    Elf64_Shdr *shdr = elf_obj.get_section_hdr(section);
+    if (!shdr) {
+      fprintf(stderr, "Section %s not found, compile the program with %s\n",
+              section, env);
+      exit(1);
+    }
+    start = shdr->sh_addr;
+    end = shdr->sh_addr + shdr->sh_size;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+      perror("fopen");
+      exit(1);
+    }
+    uint64_t buf[512];
+    size_t   got;
+    while ((got = fread(buf, sizeof(uint64_t), 512, file)) != 0) {
+      values.insert(values.end(), buf, buf + got);
+    }
+    fclose(file);
+  }
+
+  /** Index of the first counter of the array at `addr`, exit if it is not in
+   * the counter section. */
+  uint64_t index(uintptr_t addr, const char *section) const {
+    if (addr < start || addr >= end) {
+      fprintf(stderr, "Invalid counters in section %s\n", section);
+      exit(1);
+    }
+    return (addr - start) / sizeof(uint64_t);
+  }
+
+  /** Counter `idx`, exit if the dump is too short. */
+  uint64_t at(uint64_t idx, const char *section) const {
+    if (idx >= values.size()) {
+      fprintf(stderr,
+              "Counter out of range in section %s, "
+              "is the dump from this binary?\n",
+              section);
+      exit(1);
+    }
+    return values[idx];
+  }
+};
+
+/** Edges of the profiled functions and their count, see SANCOV_CFG_EPROF.
+ * Blocks are named as in BlockGraph, the caller of each function by none. */
+struct EdgeProfile {
+  static const uint64_t none = ~(uint64_t)0;
+
+  std::vector<Edge>     edges;
+  std::vector<uint64_t> count;
+  std::vector<bool>     known;
+};
+
+/** Rebuild the edges without a counter of one function: the count of a block
+ * is what enters it and what leaves it, so an edge is known once it is the
+ * last unknown edge of one of its ends. The caller closes the circulation. */
+static void solve_flow(size_t nodes, size_t first, EdgeProfile &prof,
+                       const std::vector<std::pair<uint32_t, uint32_t>> &ends) {
+  const size_t                       n = ends.size();
+  std::vector<uint32_t>              unknown(nodes, 0);
+  std::vector<uint64_t>              in(nodes, 0), out(nodes, 0);
+  std::vector<std::vector<uint32_t>> incident(nodes);
+  for (size_t i = 0; i < n; i++) {
+    const uint32_t src = ends[i].first, dst = ends[i].second;
+    if (prof.known[first + i]) {
+      out[src] += prof.count[first + i];
+      in[dst] += prof.count[first + i];
+    } else if (src != dst) {
+      unknown[src]++;
+      unknown[dst]++;
+      incident[src].push_back(i);
+      incident[dst].push_back(i);
+    }
+  }
+
+  std::vector<uint32_t> work;
+  for (uint32_t b = 0; b < nodes; b++) {
+    if (unknown[b] == 1) { work.push_back(b); }
+  }
+  while (!work.empty()) {
+    const uint32_t b = work.back();
+    work.pop_back();
+    if (unknown[b] != 1) { continue; }
+
+    for (uint32_t i : incident[b]) {
+      if (prof.known[first + i]) { continue; }
+
+      const uint32_t src = ends[i].first, dst = ends[i].second;
+      const uint64_t count = src == b ? in[b] - out[b] : out[b] - in[b];
+      prof.count[first + i] = count;
+      prof.known[first + i] = true;
+      out[src] += count;
+      in[dst] += count;
+      for (uint32_t end : {src, dst}) {
+        if (--unknown[end] == 1) { work.push_back(end); }
+      }
+      break;
+    }
+  }
+}
+
+/** Load the edges of the profiled functions and rebuild their count from the
+ * counters of a run, in the order of __sancov_eprof_cntrs. */
+static void load_edge_profile(ElfFile &cfg_obj, const GuardSpace &guards,
+                              const CounterDump &counters, EdgeProfile &prof) {
+  const char   *section = "__sancov_eprof";
+  SectionStream sec;
+  sec.open(cfg_obj, section);
+
+  uint64_t next = guards.size();
+  for_each_chunk(sec, SANCOV_CFG_EPROF, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    const size_t    n = chunk.hdr.count;
+    const uintptr_t counter_base = chunk.ptr_at(chunk.payload());
+    const size_t    blocks_at = chunk.payload() + chunk.ptr_size();
+    const uint32_t  blocks = chunk.u32_at(blocks_at);
+    const size_t    guard = blocks_at + 4;
+    const size_t    src = guard + 4 * (size_t)blocks;
+    const size_t    dst = src + 4 * n;
+    const size_t    counter = dst + 4 * n;
+
+    std::vector<uint64_t> node;
+    for (uint32_t b = 0; b < blocks; b++) {
+      const uint32_t g = chunk.u32_at(guard + 4 * b);
+      node.push_back(g == SANCOV_CFG_NONE
+                         ? next++
+                         : guards.checked_index(base, g, section));
+    }
+    auto name = [&](uint32_t b) -> uint64_t {
+      return b == blocks ? EdgeProfile::none : node[b];
+    };
+
+    const uint64_t first_counter =
+        counter_base ? counters.index(counter_base, section) : 0;
+
+    const size_t                               first = prof.edges.size();
+    std::vector<std::pair<uint32_t, uint32_t>> ends;
+    for (size_t i = 0; i < n; i++) {
+      const uint32_t s = chunk.u32_at(src + 4 * i);
+      const uint32_t d = chunk.u32_at(dst + 4 * i);
+      const uint32_t c = chunk.u32_at(counter + 4 * i);
+      if (s > blocks || d > blocks) {
+        fprintf(stderr, "Invalid block in section %s\n", section);
+        exit(1);
+      }
+      ends.push_back(std::make_pair(s, d));
+      prof.edges.push_back(Edge(name(s), name(d)));
+      if (c == SANCOV_CFG_NONE) {
+        prof.count.push_back(0);
+        prof.known.push_back(false);
+        continue;
+      }
+      if (!counter_base) {
+        fprintf(stderr, "Invalid counters in section %s\n", section);
+        exit(1);
+      }
+      prof.count.push_back(counters.at(first_counter + c, section));
+      prof.known.push_back(true);
+    }
+    solve_flow(blocks + 1, first, prof, ends);
+  });
+}
+
+/** Print `count g0 g1 ...` for each path run by the profiled functions,
+ * turning its id back into guards with the increments of SANCOV_CFG_PATHS. */
+static void print_paths(ElfFile &cfg_obj, const GuardSpace &guards,
+                        const CounterDump &counters) {
+  const char   *section = "__sancov_paths";
+  SectionStream sec;
+  sec.open(cfg_obj, section);
+
+  for_each_chunk(sec, SANCOV_CFG_PATHS, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    const size_t    n = chunk.hdr.count;
+    const size_t    paths_at = chunk.payload() + chunk.ptr_size();
+    const uint32_t  paths = chunk.u32_at(paths_at);
+    const uint32_t  entry = chunk.u32_at(paths_at + 4);
+    const size_t    src = paths_at + 8;
+    const size_t    dst = src + 4 * n;
+    const size_t    inc = dst + 4 * n;
+    const uint64_t  first =
+        counters.index(chunk.ptr_at(chunk.payload()), section);
+
+    /** out edges of each node, (inc, edge); start edges leave the entry. */
+    std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, size_t>>>
+        out;
+    for (size_t i = 0; i < n; i++) {
+      const uint32_t s = chunk.u32_at(src + 4 * i);
+      out[s == SANCOV_CFG_NONE ? entry : s].push_back(
+          std::make_pair(chunk.u32_at(inc + 4 * i), i));
+    }
+    for (auto &edges : out) {
+      std::sort(edges.second.begin(), edges.second.end());
+    }
+
+    std::vector<uint32_t> path;
+    for (uint32_t id = 0; id < paths; id++) {
+      const uint64_t count = counters.at(first + id, section);
+      if (!count) { continue; }
+
+      // the edge with the largest increment that fits what is left.
+      uint32_t left = id, cur = entry;
+      path.assign(1, entry);
+      for (size_t step = 0; step <= n; step++) {
+        auto it = out.find(cur);
+        if (it == out.end() || it->second.empty() ||
+            it->second[0].first > left) {
+          fprintf(stderr, "Invalid path increments in section %s\n",
+                  section);
+          exit(1);
+        }
+        const auto &edges = it->second;
+        auto edge = std::upper_bound(edges.begin(), edges.end(),
+                                     std::make_pair(left, (size_t)-1)) -
+                    1;
+        left -= edge->first;
+        const uint32_t s = chunk.u32_at(src + 4 * edge->second);
+        cur = chunk.u32_at(dst + 4 * edge->second);
+        if (cur == SANCOV_CFG_NONE) { break; }
+        if (s == SANCOV_CFG_NONE) { path.clear(); }
+        path.push_back(cur);
+      }
+
+      printf("%llu", (unsigned long long)count);
+      for (uint32_t g : path) {
+        printf(" %ld", (long)guards.checked_index(base, g, section));
+      }
+      printf("\n");
+    }
+  });
+}
+
+/** Print `src dst prob freq source` for each edge of __sancov_weights: the
+ * probability of the edge out of src, its runs per call of the function,
+ * and whether they follow a PGO profile or static estimates. */
+static void print_weights(ElfFile &cfg_obj, const GuardSpace &guards) {
+  const char   *section = "__sancov_weights";
+  SectionStream sec;
+  sec.open(cfg_obj, section);
+
+  for_each_chunk(sec, SANCOV_CFG_WEIGHTS, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    const size_t    n = chunk.hdr.count;
+    const bool      profile = chunk.u32_at(chunk.payload()) != 0;
+    const size_t    src = chunk.payload() + 4;
+    const size_t    dst = src + 4 * n;
+    const size_t    prob = dst + 4 * n;
+    const size_t    freq = prob + 4 * n;
+    for (size_t i = 0; i < n; i++) {
+      printf("%ld %ld %.6f %.4f %s\n",
+             (long)guards.checked_index(base, chunk.u32_at(src + 4 * i),
+                                        section),
+             (long)guards.checked_index(base, chunk.u32_at(dst + 4 * i),
+                                        section),
+             (double)chunk.u32_at(prob + 4 * i) / SANCOV_CFG_PROB_ONE,
+             (double)chunk.u32_at(freq + 4 * i) / 65536,
+             profile ? "profile" : "static");
+    }
+  });
+}
+
+/** Print `header depth parent latch...` for each loop of __sancov_loops,
+ * parent is the header of the enclosing loop or -1. */
+static void print_loops(ElfFile &cfg_obj, const GuardSpace &guards) {
+  const char   *section = "__sancov_loops";
+  SectionStream sec;
+  sec.open(cfg_obj, section);
+
+  for_each_chunk(sec, SANCOV_CFG_LOOPS, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    const size_t    n = chunk.hdr.count;
+    const size_t    header = chunk.payload();
+    const size_t    parent = header + 4 * n;
+    const size_t    depth = parent + 4 * n;
+    const size_t    end = depth + 4 * n;
+    const size_t    latch = end + 4 * n;
+    auto guard = [&](size_t at) {
+      return (long)guards.checked_index(base, chunk.u32_at(at), section);
+    };
+
+    uint32_t begin = 0;
+    for (size_t i = 0; i < n; i++) {
+      const uint32_t up = chunk.u32_at(parent + 4 * i);
+      const uint32_t stop = chunk.u32_at(end + 4 * i);
+      if (stop < begin || (up != SANCOV_CFG_NONE && up >= i)) {
+        fprintf(stderr, "Invalid loop in section %s\n", section);
+        exit(1);
+      }
+      printf("%ld %u %ld", guard(header + 4 * i), chunk.u32_at(depth + 4 * i),
+             up == SANCOV_CFG_NONE ? -1L : guard(header + 4 * up));
+      for (uint32_t j = begin; j < stop; j++) {
+        printf(" %ld", guard(latch + 4 * j));
+      }
+      printf("\n");
+      begin = stop;
+    }
+  });
+}
+
+/** Print `guard id` for each guard of __sancov_ids, id being the hash of
+ * the function name and of the position of the block, in 16 hex digits. */
+static void print_ids(ElfFile &cfg_obj, const GuardSpace &guards) {
+  const char   *section = "__sancov_ids";
+  SectionStream sec;
+  sec.open(cfg_obj, section);
+
+  for_each_chunk(sec, SANCOV_CFG_IDS, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    const uint64_t  func = chunk.u32_at(chunk.payload());
+    const size_t    id = chunk.payload() + 4;
+    for (size_t i = 0; i < chunk.hdr.count; i++) {
+      const uint32_t value = chunk.u32_at(id + 4 * i);
+      if (value == SANCOV_CFG_NONE) { continue; }
+      printf("%ld %016llx\n", (long)guards.checked_index(base, i, section),
+             (unsigned long long)(func << 32 | value));
+    }
+  });
+}
+
+/** Functions of __sancov_funcs, sorted by their first guard. Guard ranges
+ * are disjoint, a guard is mapped to its function by binary search. The
+ * linker usually keeps the chunks in guard order already. */
+struct FuncTable {
+  struct Func {
+    uint64_t    first;
+    uint64_t    last;   // one past the last guard
+    uint64_t    entry;  // guards.size() if the entry block has no guard
+    uint32_t    blocks;
+    std::string name;
+  };
+  std::vector<Func> funcs;
+
+  void load(ElfFile &cfg_obj, const GuardSpace &guards) {
+    const char   *section = "__sancov_funcs";
+    const char   *names_section = "__sancov_func_names";
+    SectionStream sec;
+    sec.open(cfg_obj, section);
+
+    std::vector<uint8_t> names;
+    Elf64_Shdr          *names_hdr = cfg_obj.get_section_hdr(names_section);
+    if (!names_hdr || !cfg_obj.read_section(names_section, names)) {
+      fprintf(stderr, "Cannot read section %s\n", names_section);
+      exit(1);
+    }
+
+    for_each_chunk(sec, SANCOV_CFG_FUNCS, [&](const Chunk &chunk) {
+      const uintptr_t base = chunk.guards();
+      const size_t    n = chunk.hdr.count;
+      const size_t    name = chunk.payload() + chunk.ptr_size() * n;
+      const size_t    size = name + 4 * n;
+      const size_t    entry = size + 4 * n;
+      const size_t    blocks = entry + 4 * n;
+      for (size_t i = 0; i < n; i++) {
+        const uint32_t count = chunk.u32_at(size + 4 * i);
+        const uint32_t head = chunk.u32_at(entry + 4 * i);
+        const uint64_t off = chunk.off_at(name + 4 * i) - names_hdr->sh_addr;
+        if (count == 0 || off >= names.size() ||
+            !memchr(names.data() + off, 0, names.size() - off)) {
+          fprintf(stderr, "Invalid function in section %s\n", section);
+          exit(1);
+        }
+
+        Func func;
+        func.first = guards.checked_index(base, 0, section);
+        func.last = guards.checked_index(base, count - 1, section) + 1;
+        func.entry = head == SANCOV_CFG_NONE
+                         ? guards.size()
+                         : guards.checked_index(base, head, section);
+        func.blocks = chunk.u32_at(blocks + 4 * i);
+        func.name = (const char *)names.data() + off;
+        funcs.push_back(func);
+      }
+    });
+    auto by_first = [](const Func &a, const Func &b) {
+      return a.first < b.first;
+    };
+    if (!std::is_sorted(funcs.begin(), funcs.end(), by_first)) {
+      std::sort(funcs.begin(), funcs.end(), by_first);
+    }
+  }
+
+  /** Function owning `guard`, nullptr if none. */
+  const Func *find(uint64_t guard) const {
+    auto it = std::upper_bound(
+        funcs.begin(), funcs.end(), guard,
+        [](uint64_t g, const Func &func) { return g < func.first; });
+    if (it == funcs.begin() || guard >= (it - 1)->last) { return nullptr; }
+    return &*(it - 1);
+  }
+
+  /** Function named `name`, or owning the guard `name` is the index of. */
+  const Func *find(const char *name) const {
+    char          *end;
+    const uint64_t guard = strtoull(name, &end, 10);
+    if (*name && !*end) { return find(guard); }
+    for (const auto &func : funcs) {
+      if (func.name == name) { return &func; }
+    }
+    return nullptr;
+  }
+};
+
+/** Rewrite dist[] of the SANCOV_CFG_DIST chunks of `input` in place with the
+ * distance of each guard to the nearest target through the edges and calls
+ * of edge_list, from the distances the compiler found within each function.
+ * Return the number of guards that reach a target. */
+static size_t finalize_distances(const char *input, ElfFile &elf_obj,
+                                 const GuardSpace        &guards,
+                                 const std::vector<Edge> &edge_list) {
+  const char *section = "__sancov_dist";
+  Elf64_Shdr *shdr = elf_obj.get_section_hdr(section);
+  if (!shdr || shdr->sh_type == SHT_NOBITS) {
+    fprintf(stderr,
+            "Section %s not found, compile the program with "
+            "CFG_TARGETS=<file>\n",
+            section);
+    exit(1);
+  }
+
+  /** dist[] of `count` guards from `base`, at `off` in the file. */
+  struct DistColumn {
+    uintptr_t base;
+    uint32_t  count;
+    off_t     off;
+  };
+  const uint32_t          none = SANCOV_CFG_NONE;
+  std::vector<uint32_t>   dist(guards.size(), none);
+  std::vector<DistColumn> columns;
+  SectionStream           sec;
+  sec.open(elf_obj, section);
+  for_each_chunk(sec, SANCOV_CFG_DIST, [&](const Chunk &chunk) {
+    const uintptr_t base = chunk.guards();
+    for (uint32_t i = 0; i < chunk.hdr.count; i++) {
+      const uint64_t g = guards.checked_index(base, i, section);
+      dist[g] = std::min(dist[g], chunk.u32_at(chunk.payload() + 4 * i));
+    }
+    columns.push_back({base, chunk.hdr.count,
+                       (off_t)(shdr->sh_offset + (chunk.addr - sec.addr) +
+                               chunk.payload())});
+  });
+
+  /** predecessors of each guard, CSR. */
+  std::vector<size_t>   begin(guards.size() + 1, 0);
+  std::vector<uint64_t> preds(edge_list.size());
+  for (const auto &edge : edge_list) { begin[edge.second + 1]++; }
+  for (size_t g = 0; g < guards.size(); g++) { begin[g + 1] += begin[g]; }
+  std::vector<size_t> fill(begin.begin(), begin.end() - 1);
+  for (const auto &edge : edge_list) { preds[fill[edge.second]++] = edge.first; }
+
+  // Dijkstra with unit edges, the compiler's distances are the sources.
+  typedef std::pair<uint32_t, uint64_t> Item;
+  std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+  for (uint64_t g = 0; g < dist.size(); g++) {
+    if (dist[g] != none) { queue.push(Item(dist[g], g)); }
+  }
+  while (!queue.empty()) {
+    const Item item = queue.top();
+    queue.pop();
+    if (item.first != dist[item.second] || item.first + 1 == none) {
+      continue;
+    }
+    for (size_t i = begin[item.second]; i < begin[item.second + 1]; i++) {
+      if (dist[preds[i]] > item.first + 1) {
+        dist[preds[i]] = item.first + 1;
+        queue.push(Item(item.first + 1, preds[i]));
+      }
+    }
+  }
+
+  int fd = open(input, O_WRONLY);
+  if (fd == -1) {
+    perror("open");
+    exit(1);
+  }
+  std::vector<uint32_t> column;
+  for (const auto &col : columns) {
+    column.resize(col.count);
+    for (uint32_t i = 0; i < col.count; i++) {
+      column[i] = dist[guards.checked_index(col.base, i, section)];
+    }
+    const size_t bytes = column.size() * sizeof(uint32_t);
+    if (pwrite(fd, column.data(), bytes, col.off) != (ssize_t)bytes) {
+      perror("pwrite");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  return dist.size() - std::count(dist.begin(), dist.end(), none);
+}
+
+/** Entry guards of the functions that code without guards may call: static
+ * constructors and destructors, and functions whose address is taken. */
+static void load_roots(ElfFile &cfg_obj, const GuardSpace &guards,
+                       std::vector<uint64_t> &roots) {
+  const char   *section = "__sancov_icalls";
+  SectionStream sec;
+  sec.open(cfg_obj, section);
+
+  for_each_chunk(sec, SANCOV_CFG_ICALLS, [&](const Chunk &chunk) {
+    const size_t   entry = chunk.payload();
+    const uint32_t head = chunk.u32_at(entry);
+    if (head != SANCOV_CFG_NONE &&
+        (chunk.u32_at(entry + 8) &
+         (SANCOV_CFG_ADDR_TAKEN | SANCOV_CFG_ADDR_INIT))) {
+      roots.push_back(guards.checked_index(chunk.guards(), head, section));
+    }
+  });
+}
+
+/** Print a special case list of the functions of `table` that the edges
+ * and calls of edge_list do not reach from `roots` and the functions named
+ * after an entry point. A function whose name a reachable one shares (local
+ * functions of different files) is kept, the list matches by name. */
+static void print_unreachable(const FuncTable &table, const GuardSpace &guards,
+                              std::vector<Edge>    &edge_list,
+                              std::vector<uint64_t> roots) {
+  static const char *entry_points[] = {
+      "main", "LLVMFuzzerTestOneInput", "LLVMFuzzerInitialize",
+      "LLVMFuzzerCustomMutator", "LLVMFuzzerCustomCrossOver"};
+  for (const auto &func : table.funcs) {
+    for (const char *name : entry_points) {
+      if (func.name == name) { roots.push_back(func.entry); }
+    }
+  }
+
+  std::sort(edge_list.begin(), edge_list.end());
+  std::vector<bool> reached(guards.size() + 1);
+  for (size_t head = 0; head < roots.size(); head++) {
+    const uint64_t u = roots[head];
+    if (reached[u]) { continue; }
+    reached[u] = true;
+    if (u == guards.size()) { continue; }
+    for (auto it = std::lower_bound(edge_list.begin(), edge_list.end(),
+                                    Edge(u, 0));
+         it != edge_list.end() && it->first == u; ++it) {
+      if (!reached[it->second]) { roots.push_back(it->second); }
+    }
+  }
+
+  // without an entry guard, the callers of a function are unknown.
+  std::unordered_set<std::string> kept;
+  for (const auto &func : table.funcs) {
+    if (func.entry == guards.size() || reached[func.entry]) {
+      kept.insert(func.name);
+    }
+  }
+
+  size_t count = 0;
+  printf("# functions unreachable from main and the fuzz entry points\n");
+  for (const auto &func : table.funcs) {
+    if (kept.count(func.name)) { continue; }
+    // special case lists are patterns, match the symbol literally.
+    std::string pattern;
+    for (char c : func.name) {
+      if (!isalnum((unsigned char)c) && c != '_') { pattern += '\\'; }
+      pattern += c;
+    }
+    printf("fun:%s\n", pattern.c_str());
+    count++;
+  }
+  fprintf(stderr, "%zu of %zu functions unreachable\n", count,
+          table.funcs.size());
+}
+
 int main(int argc, char **argv) {
-  if (argc != 2) {
+  bool        blocks = false;
+  bool        distances = false;
+  bool        weights = false;
+  bool        loops = false;
+  bool        funcs = false;
+  uint32_t    icalls = 0;
+  bool        returns = false;
+  bool        valid_paths = false;
+  bool        ids = false;
+  bool        unreachable = false;
+  const char *slice = nullptr;
+  const char *coverage = nullptr;
+  const char *profile = nullptr;
+  const char *paths = nullptr;
+  int         opt;
+  while ((opt = getopt(argc, argv, "bc:dfF:iIlp:P:rRsuw")) != -1) {
+    switch (opt) {
+      case 'b':
+        blocks = true;
+        break;
+      case 'c':
+        coverage = optarg;
+        break;
+      case 'd':
+        distances = true;
+        break;
+      case 'f':
+        funcs = true;
+        break;
+      case 'F':
+        slice = optarg;
+        break;
+      case 'i':
+        icalls |= SANCOV_CFG_ADDR_TAKEN;
+        break;
+      case 'I':
+        icalls |= SANCOV_CFG_ADDR_TAKEN | SANCOV_CFG_ADDR_EXTERN;
+        break;
+      case 'l':
+        loops = true;
+        break;
+      case 'p':
+        profile = optarg;
+        break;
+      case 'P':
+        paths = optarg;
+        break;
+      case 'r':
+        returns = true;
+        break;
+      case 'R':
+        valid_paths = true;
+        break;
+      case 's':
+        ids = true;
+        break;
+      case 'u':
+        unreachable = true;
+        break;
+      case 'w':
+        weights = true;
+        break;
+      default:
+        std::cerr << usage;
+        return 1;
+    }
+  }
+  if ((argc - optind != 1 && argc - optind != 2) ||
+      (valid_paths && (blocks || distances))) {
+    // the labels name guards, and distances count every edge alike.
     std::cerr << usage;
     return 1;
   }
+  const char *input = argv[optind];
+  const char *sidecar_dir = argc - optind == 2 ? argv[optind + 1] : nullptr;
 
   ElfFile elf_obj;
-  elf_obj.open(argv[1]);
-
-  /** Read the address of sancov guard. */
-  Elf64_Shdr *sancov_guard_sec = elf_obj.get_section_hdr("__sancov_guards");
-  assert(sancov_guard_sec &&
-         "Section __sancov_guards not found in the ELF file\n"
-         "compile the program with -fsanitize-coverage=trace-pc-guard,pc-table "
-         "to generate this section.\n");
-  void *start_sancov_guard = (void *)sancov_guard_sec->sh_addr;
-  void *end_sancov_guard = (void *)(sancov_guard_sec->sh_addr 
-                                  + sancov_guard_sec->sh_size);
-
-  /** Load intra control-flow, ie. edges between basic blocks
-   *  inside a function.
-   */
-  Elf64_Shdr *sancov_cfg_edges_sec =
-      elf_obj.get_section_hdr("__sancov_cfg_edges");
-  struct SancovCfgEdge *edges =
-      (struct SancovCfgEdge *)xmalloc(sancov_cfg_edges_sec->sh_size);
-  if (!elf_obj.get_section_data("__sancov_cfg_edges", (uint8_t *)edges)) {
-    fprintf(
-        stderr,
-        "Cannot read section __sancov_cfg_edges\n"
-        "compile the program with -fsanitize-coverage=trace-pc-guard,pc-table "
-        "to generate this section.\n");
+  elf_obj.open(input);
+
+  /** Read the address of sancov guard, counters or flags. */
+  Elf64_Shdr *sancov_guard_sec = nullptr;
+  GuardSpace  guards;
+  for (const auto &sec : guard_sections) {
+    if ((sancov_guard_sec = elf_obj.get_section_hdr(sec.name)) != nullptr) {
+      guards.elem = sec.elem;
+      break;
+    }
+  }
+  if (!sancov_guard_sec) {
+    fprintf(stderr, "Section __sancov_guards not found in the ELF file\n%s",
+            hint);
     exit(1);
   }
-  std::vector<std::pair<void *, void *>> edge_list;
-  struct {
-    bool operator()(const std::pair<void *, void *> &a,
-                    const std::pair<void *, void *> &b) const {
-      return a.first < b.first || (a.first == b.first && a.second < b.second);
-    }
-  } edgeCmp;
-  for (uint16_t i = 0;
-       i < sancov_cfg_edges_sec->sh_size / sizeof(SancovCfgEdge); i++) {
-    SancovCfgEdge &edge = edges[i];
-    if (!edge.src || !edge.dst) {
-      // Skip edges with null src or dst.
-      continue;
+  guards.start = sancov_guard_sec->sh_addr;
+  guards.end = sancov_guard_sec->sh_addr + sancov_guard_sec->sh_size;
+
+  /** The cfg sections are in the sidecar if they were split off. */
+  const char *cfg_section = paths     ? "__sancov_paths"
+                            : profile ? "__sancov_eprof"
+                            : weights ? "__sancov_weights"
+                            : loops   ? "__sancov_loops"
+                            : ids     ? "__sancov_ids"
+                            : funcs || slice || unreachable ? "__sancov_funcs"
+                                      : "__sancov_cfg_edges";
+  ElfFile     sidecar;
+  ElfFile    *cfg_obj = &elf_obj;
+  if (!elf_obj.get_section_hdr(cfg_section)) {
+    std::string dir = sidecar_dir ? sidecar_dir : input;
+    std::string path;
+    if (!sidecar_dir) {
+      const size_t slash = dir.rfind('/');
+      dir = slash == std::string::npos ? "." : dir.substr(0, slash);
+    }
+    if (sidecar_path(elf_obj, dir, path)) {
+      sidecar.open(path.c_str());
+      cfg_obj = &sidecar;
     }
-    assert(
-        edge.src >= start_sancov_guard && edge.dst >= start_sancov_guard &&
-        "Invalid edge in __sancov_cfg_edges section\n"
-        "compile the program with -fsanitize-coverage=trace-pc-guard,pc-table "
-        "to generate this section.\n");
-    assert(
-        edge.src < end_sancov_guard && edge.dst < end_sancov_guard &&
-        "Invalid edge in __sancov_cfg_edges section\n"
-        "compile the program with -fsanitize-coverage=trace-pc-guard,pc-table "
-        "to generate this section.\n");
-    std::pair<void *, void *> dat;
-    dat.first = edge.src;
-    dat.second = edge.dst;
-    edge_list.push_back(dat);
-  }
-  free(edges);
-
-  /** Load the guard to the entry block of each function.*/
-  std::unordered_map<void *, void *> func_to_entry_block;
-  Elf64_Shdr *sancov_entry_sec = elf_obj.get_section_hdr("__sancov_entries");
-  struct SancovEntry *entries =
-      (struct SancovEntry *)xmalloc(sancov_entry_sec->sh_size);
-  if (!elf_obj.get_section_data("__sancov_entries", (uint8_t *)entries)) {
-    fprintf(
-        stderr,
-        "Cannot read section __sancov_entries\n"
-        "compile the program with -fsanitize-coverage=trace-pc-guard,pc-table "
-        "to generate this section.\n");
-    exit(1);
   }
-  for (uint16_t i = 0; i < sancov_entry_sec->sh_size / sizeof(SancovEntry);
-       i++) {
-    SancovEntry &entry = entries[i];
-    if (entry.func && entry.guard) {
-      assert(entry.guard >= start_sancov_guard &&
-             "Invalid entry in __sancov_entries section\n"
-             "compile the program with "
-             "-fsanitize-coverage=trace-pc-guard,pc-table "
-             "to generate this section.\n");
-      assert(entry.guard < end_sancov_guard &&
-             "Invalid entry in __sancov_entries section\n"
-             "compile the program with "
-             "-fsanitize-coverage=trace-pc-guard,pc-table "
-             "to generate this section.\n");
-      func_to_entry_block[entry.func] = entry.guard;
-    }
-  }
-  free(entries);
-
-  /** Stitch inter-function control flow graph. */
-  Elf64_Shdr *sancov_func_call_sec = elf_obj.get_section_hdr("__sancov_func");
-  struct SancovFuncCall *calls =
-      (struct SancovFuncCall *)xmalloc(sancov_func_call_sec->sh_size);
-  if (!elf_obj.get_section_data("__sancov_func", (uint8_t *)calls)) {
-    fprintf(
-        stderr,
-        "Cannot read section __sancov_func_calls\n"
-        "compile the program with -fsanitize-coverage=trace-pc-guard,pc-table "
-        "to generate this section.\n");
-    exit(1);
+
+  BlockGraph graph;
+  if (blocks || coverage) { load_blocks(*cfg_obj, guards, graph); }
+
+  if (coverage) {
+    FILE *file = fopen(coverage, "r");
+    if (!file) {
+      perror("fopen");
+      exit(1);
+    }
+    std::vector<uint64_t> covered;
+    unsigned long         guard;
+    while (fscanf(file, "%lu", &guard) == 1) { covered.push_back(guard); }
+    fclose(file);
+
+    infer_coverage(graph, covered);
+    std::sort(covered.begin(), covered.end());
+    covered.erase(std::unique(covered.begin(), covered.end()), covered.end());
+    for (uint64_t node : covered) { printf("%ld\n", (long)node); }
+    return 0;
+  }
+
+  if (weights) {
+    print_weights(*cfg_obj, guards);
+    return 0;
+  }
+
+  if (loops) {
+    print_loops(*cfg_obj, guards);
+    return 0;
+  }
+
+  if (ids) {
+    print_ids(*cfg_obj, guards);
+    return 0;
+  }
+
+  FuncTable table;
+  if (funcs || slice || unreachable) { table.load(*cfg_obj, guards); }
+  if (funcs) {
+    for (const auto &func : table.funcs) {
+      printf("%ld %ld %ld %u %s\n", (long)func.first, (long)func.last,
+             func.entry == guards.size() ? -1L : (long)func.entry,
+             func.blocks, func.name.c_str());
+    }
+    return 0;
+  }
+
+  if (paths) {
+    CounterDump counters;
+    counters.open(elf_obj, "__sancov_path_cntrs", "CFG_PATHS=1", paths);
+    print_paths(*cfg_obj, guards, counters);
+    return 0;
   }
-  for (uint16_t i = 0;
-       i < sancov_func_call_sec->sh_size / sizeof(SancovFuncCall); i++) {
-    SancovFuncCall &call = calls[i];
-    if (call.func && call.guard) {
-      assert(call.guard >= start_sancov_guard &&
-             "Invalid call in __sancov_func_calls section\n"
-             "compile the program with "
-             "-fsanitize-coverage=trace-pc-guard,pc-table "
-             "to generate this section.\n");
-      assert(call.guard < end_sancov_guard &&
-             "Invalid call in __sancov_func_calls section\n"
-             "compile the program with "
-             "-fsanitize-coverage=trace-pc-guard,pc-table "
-             "to generate this section.\n");
-      std::pair<void *, void *> dat;
-
-      auto ptr = func_to_entry_block.find(call.func);
-      if (ptr != func_to_entry_block.end()) {
-        dat.first = call.guard;
-        dat.second = ptr->second;
-        edge_list.push_back(dat);
+
+  if (profile) {
+    CounterDump counters;
+    counters.open(elf_obj, "__sancov_eprof_cntrs", "CFG_EDGE_PROF=1", profile);
+
+    EdgeProfile prof;
+    load_edge_profile(*cfg_obj, guards, counters, prof);
+
+    /** Edges to and from the caller are not printed, the calls are. */
+    size_t unknown = 0;
+    for (size_t i = 0; i < prof.edges.size(); i++) {
+      const Edge &edge = prof.edges[i];
+      if (edge.first == EdgeProfile::none || edge.second == EdgeProfile::none) {
+        continue;
       }
+      if (!prof.known[i]) {
+        unknown++;
+        continue;
+      }
+      printf("%ld %ld %llu\n", (long)edge.first, (long)edge.second,
+             (unsigned long long)prof.count[i]);
+    }
+    if (unknown) {
+      fprintf(stderr, "%zu edges without a counter could not be rebuilt\n",
+              unknown);
     }
+    return 0;
+  }
+
+  std::vector<Edge>                       edge_list, call_list;
+  std::vector<Return>                     return_list;
+  std::unordered_map<uintptr_t, uint64_t> func_to_entry_block;
+  load_edges(*cfg_obj, guards, edge_list);
+  load_entries(*cfg_obj, guards, func_to_entry_block);
+  load_calls(*cfg_obj, guards, func_to_entry_block, call_list);
+  if (icalls) { load_icalls(*cfg_obj, guards, icalls, call_list); }
+  std::sort(call_list.begin(), call_list.end());
+  call_list.erase(std::unique(call_list.begin(), call_list.end()),
+                  call_list.end());
+
+  /** Functions are reached through their entry guard, by calls and by
+   * indirect calls of their signature (as -I), at the guard level: pruned
+   * blocks do not matter. */
+  if (unreachable) {
+    std::vector<uint64_t> roots;
+    load_roots(*cfg_obj, guards, roots);
+    load_icalls(*cfg_obj, guards,
+                SANCOV_CFG_ADDR_TAKEN | SANCOV_CFG_ADDR_EXTERN, call_list);
+    edge_list.insert(edge_list.end(), call_list.begin(), call_list.end());
+    print_unreachable(table, guards, edge_list, roots);
+    return 0;
+  }
+
+  if (returns || valid_paths) {
+    load_returns(*cfg_obj, guards, call_list, return_list);
+  }
+
+  // the exits of pruned functions are guards, not blocks.
+  if (!valid_paths) {
+    edge_list.insert(edge_list.end(), call_list.begin(), call_list.end());
+    call_list.clear();
+  }
+  if (blocks) { expand_blocks(graph, func_to_entry_block, edge_list); }
+  if (returns && !valid_paths) {
+    for (const auto &ret : return_list) { edge_list.push_back(ret.first); }
+    return_list.clear();
+  }
+
+  if (distances) {
+    const size_t reaching =
+        finalize_distances(input, elf_obj, guards, edge_list);
+    printf("%zu of %llu guards reach a target\n", reaching,
+           (unsigned long long)guards.size());
+    return 0;
+  }
+
+  /** Only the edges out of one function, calls included. */
+  if (slice) {
+    const FuncTable::Func *func = table.find(slice);
+    if (!func) {
+      fprintf(stderr, "No function %s in section __sancov_funcs\n", slice);
+      exit(1);
+    }
+    auto outside = [&](const Edge &edge) {
+      return edge.first < func->first || edge.first >= func->last;
+    };
+    edge_list.erase(
+        std::remove_if(edge_list.begin(), edge_list.end(), outside),
+        edge_list.end());
+    call_list.erase(
+        std::remove_if(call_list.begin(), call_list.end(), outside),
+        call_list.end());
+    return_list.erase(std::remove_if(return_list.begin(), return_list.end(),
+                                     [&](const Return &ret) {
+                                       return outside(ret.first);
+                                     }),
+                      return_list.end());
   }
-  free(calls);
 
   /** Sort, dedup and print the control flow graph. */
-  std::sort(edge_list.begin(), edge_list.end(), edgeCmp);
-  const size_t len = edge_list.size();
-  size_t       i = 0;
-  while (i < len) {
-    size_t      j = i + 1;
-    const auto &edge = edge_list[i];
-    // dedup
-    while (j < len && edge.first == edge_list[j].first &&
-           edge.second == edge_list[j].second) {
-      j++;
-    }
-    printf("%ld %ld\n",
-           ((uintptr_t)edge.first - (uintptr_t)start_sancov_guard) / 4,
-           ((uintptr_t)edge.second - (uintptr_t)start_sancov_guard) / 4);
-    i = j;
+  std::sort(edge_list.begin(), edge_list.end());
+  edge_list.erase(std::unique(edge_list.begin(), edge_list.end()),
+                  edge_list.end());
+  for (const auto &edge : edge_list) {
+    printf("%ld %ld\n", (long)edge.first, (long)edge.second);
+  }
+  for (const auto &call : call_list) {
+    printf("%ld %ld (%ld\n", (long)call.first, (long)call.second,
+           (long)call.first);
+  }
+  std::sort(return_list.begin(), return_list.end());
+  return_list.erase(std::unique(return_list.begin(), return_list.end()),
+                    return_list.end());
+  for (const auto &ret : return_list) {
+    printf("%ld %ld )%ld\n", (long)ret.first.first, (long)ret.first.second,
+           (long)ret.second);
   }
 
   return 0;
@@ -0,0 +1,46 @@
+#!/usr/bin/env sh
+# Move the cfg sections of a binary linked with CFG_NOALLOC=1 into a sidecar
+# file named after its build-id, <dir>/.build-id/xx/yyyy.cfg, which cfgdump
+# looks up when the binary has no cfg sections. dir defaults to the directory
+# of the binary.
+#
+# Only non-allocated sections can be removed, allocated ones are part of the
+# loaded image.
+set -e
+
+if [ $# -lt 1 ] || [ $# -gt 2 ]; then
+  echo "Usage: cfgsplit.sh <binary> [sidecar dir]" >&2
+  exit 1
+fi
+
+bin=$1
+dir=${2:-$( dirname "$bin" )}
+sections="__sancov_cfg_edges __sancov_func __sancov_entries __sancov_blocks __sancov_eprof __sancov_paths __sancov_weights __sancov_loops __sancov_funcs __sancov_func_names __sancov_icalls __sancov_returns __sancov_ids"
+
+id=$( readelf -n "$bin" | sed -n 's/^ *Build ID: *\([0-9a-f]*\).*/\1/p' )
+if [ -z "$id" ]; then
+  echo "No build-id in $bin, link with -Wl,--build-id" >&2
+  exit 1
+fi
+
+for sec in $sections; do
+  # non-allocated sections have no address.
+  addr=$( readelf -W -S "$bin" | sed 's/^.*\]//' | awk -v s="$sec" '$1 == s { print $3 }' )
+  if [ -n "$addr" ] && [ -n "$( echo "$addr" | tr -d 0 )" ]; then
+    echo "$sec is allocated in $bin, link with CFG_NOALLOC=1" >&2
+    exit 1
+  fi
+done
+
+out=$dir/.build-id/$( echo "$id" | cut -c1-2 )/$( echo "$id" | cut -c3- ).cfg
+mkdir -p "$( dirname "$out" )"
+
+keep=""
+remove=""
+for sec in $sections; do
+  keep="$keep --only-section=$sec"
+  remove="$remove --remove-section=$sec"
+done
+objcopy $keep "$bin" "$out"
+objcopy $remove "$bin"
+echo "$out"
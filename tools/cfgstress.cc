@@ -0,0 +1,96 @@
+// Generate a C program with one huge function, to measure compile time and
+// peak memory of the cfg passes as a function grows.
+//
+// usage: cfgstress <switch|goto> <states> [seed] > stress.c
+//   switch: a state machine, one `case` per state, in a loop.
+//   goto:   a parser table, one label per state, with computed transitions.
+// Each state yields 3 to 4 basic blocks.
+//
+// Example:
+//   cfgstress switch 50000 > stress.c
+//   /usr/bin/time -v wrapper/cc -O0 -c stress.c -o stress.o
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char *usage = "Usage: cfgstress <switch|goto> <states> [seed]\n";
+
+static unsigned long next_rand;
+
+static unsigned stress_rand(unsigned bound) {
+  next_rand = next_rand * 1103515245 + 12345;
+  return (unsigned)((next_rand >> 16) % bound);
+}
+
+static void emit_switch(unsigned states) {
+  printf("int cfg_stress(const unsigned char *input, unsigned long len) {\n");
+  printf("  unsigned long i;\n");
+  printf("  int state = 0, acc = 0;\n");
+  printf("  for (i = 0; i < len; i++) {\n");
+  printf("    switch (state) {\n");
+  for (unsigned s = 0; s < states; s++) {
+    printf("      case %u:\n", s);
+    printf("        if (input[i] == %u) {\n", stress_rand(256));
+    printf("          state = %u;\n", stress_rand(states));
+    printf("        } else {\n");
+    printf("          state = %u;\n", stress_rand(states));
+    printf("          acc += %u;\n", stress_rand(7) + 1);
+    printf("        }\n");
+    printf("        break;\n");
+  }
+  printf("      default:\n");
+  printf("        return -1;\n");
+  printf("    }\n");
+  printf("  }\n");
+  printf("  return acc + state;\n");
+  printf("}\n");
+}
+
+static void emit_goto(unsigned states) {
+  printf("int cfg_stress(const unsigned char *input, unsigned long len) {\n");
+  printf("  unsigned long i = 0;\n");
+  printf("  int acc = 0;\n");
+  printf("  unsigned char c;\n");
+  for (unsigned s = 0; s < states; s++) {
+    printf("L%u:\n", s);
+    printf("  if (i >= len) return acc;\n");
+    printf("  c = input[i++];\n");
+    printf("  if (c < %u) goto L%u;\n", stress_rand(256), stress_rand(states));
+    printf("  acc += c;\n");
+    printf("  if (c & %u) goto L%u;\n", 1u << stress_rand(8),
+           stress_rand(states));
+    printf("  goto L%u;\n", stress_rand(states));
+  }
+  printf("}\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3 && argc != 4) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  const unsigned states = (unsigned)strtoul(argv[2], nullptr, 0);
+  next_rand = argc == 4 ? strtoul(argv[3], nullptr, 0) : 42;
+  if (states == 0) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  printf("/* generated by cfgstress %s %u */\n", argv[1], states);
+  if (strcmp(argv[1], "switch") == 0) {
+    emit_switch(states);
+  } else if (strcmp(argv[1], "goto") == 0) {
+    emit_goto(states);
+  } else {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  printf("\n");
+  printf("int main(int argc, char **argv) {\n");
+  printf("  return cfg_stress((const unsigned char *)argv[0], argc) & 1;\n");
+  printf("}\n");
+  return 0;
+}
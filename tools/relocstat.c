@@ -0,0 +1,167 @@
+// count the dynamic relocations applied to each section of an ELF file, to
+// check that the cfg sections built with CFG_FORMAT=rel cost nothing at load
+// time.
+// usage: relocstat <binary>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <elf.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef SHT_RELR
+#define SHT_RELR 19
+#endif
+
+static inline void xseek(int fd, off_t offset, int whence) {
+    if (lseek(fd, offset, whence) == (off_t)-1) {
+        perror("lseek");
+        exit(1);
+    }
+}
+
+static inline ssize_t xread(int fd, void *buf, size_t count) {
+    ssize_t ret = read(fd, buf, count);
+    if (ret == -1) {
+        perror("read");
+        exit(1);
+    }
+    return ret;
+}
+
+static inline void *xmalloc(size_t size) {
+    void *ptr = malloc(size);
+    if (!ptr) {
+        perror("malloc");
+        exit(1);
+    }
+
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+/* index of the allocated section that contains addr, or -1. */
+static int find_section(const Elf64_Ehdr *ehdr, const Elf64_Shdr *shdrs,
+                        Elf64_Addr addr) {
+    for (uint16_t i = 0; i < ehdr->e_shnum; i++) {
+        if ((shdrs[i].sh_flags & SHF_ALLOC) && addr >= shdrs[i].sh_addr &&
+            addr < shdrs[i].sh_addr + shdrs[i].sh_size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* charge the relocation at addr to its section. */
+static void count_reloc(const Elf64_Ehdr *ehdr, const Elf64_Shdr *shdrs,
+                        Elf64_Addr addr, size_t *count, size_t *unknown) {
+    int sec = find_section(ehdr, shdrs, addr);
+    if (sec < 0) {
+        (*unknown)++;
+    } else {
+        count[sec]++;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: relocstat <binary>\n");
+        return 1;
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd == -1) {
+        perror("open");
+        return 1;
+    }
+    static Elf64_Ehdr ehdr;
+    xread(fd, &ehdr, sizeof(ehdr));
+    if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr.e_ident[EI_CLASS] != ELFCLASS64) {
+        fprintf(stderr, "Not a valid ELF64 file: %s\n", argv[1]);
+        return 1;
+    }
+
+    Elf64_Shdr *shdrs = (Elf64_Shdr *)xmalloc(ehdr.e_shentsize * ehdr.e_shnum);
+    xseek(fd, ehdr.e_shoff, SEEK_SET);
+    xread(fd, shdrs, ehdr.e_shentsize * ehdr.e_shnum);
+
+    const Elf64_Shdr *strhdr = &shdrs[ehdr.e_shstrndx];
+    char *strtab = (char *)xmalloc(strhdr->sh_size);
+    xseek(fd, strhdr->sh_offset, SEEK_SET);
+    xread(fd, strtab, strhdr->sh_size);
+
+    /* Relocations the loader applies live in allocated SHT_RELA/SHT_REL
+     * sections (.rela.dyn, .rela.plt) and, with -z pack-relative-relocs,
+     * SHT_RELR (.relr.dyn); those of an object file do not. */
+    size_t *count = (size_t *)xmalloc(sizeof(size_t) * ehdr.e_shnum);
+    size_t total = 0, unknown = 0;
+    for (uint16_t i = 0; i < ehdr.e_shnum; i++) {
+        if ((shdrs[i].sh_type != SHT_RELA && shdrs[i].sh_type != SHT_REL &&
+             shdrs[i].sh_type != SHT_RELR) ||
+            !(shdrs[i].sh_flags & SHF_ALLOC) || shdrs[i].sh_entsize == 0) {
+            continue;
+        }
+
+        uint8_t *rel = (uint8_t *)xmalloc(shdrs[i].sh_size);
+        xseek(fd, shdrs[i].sh_offset, SEEK_SET);
+        xread(fd, rel, shdrs[i].sh_size);
+
+        /* SHT_RELR holds R_*_RELATIVE relocations of words: an even entry is
+         * the address of one, an odd entry a bitmap of the 63 words after
+         * the last address (bit 1 for the first). */
+        Elf64_Addr where = 0;
+        for (size_t j = 0; shdrs[i].sh_type == SHT_RELR &&
+                           j + sizeof(Elf64_Addr) <= shdrs[i].sh_size;
+             j += sizeof(Elf64_Addr)) {
+            Elf64_Addr entry;
+            memcpy(&entry, rel + j, sizeof(entry));
+            if ((entry & 1) == 0) {
+                count_reloc(&ehdr, shdrs, entry, count, &unknown);
+                total++;
+                where = entry + sizeof(Elf64_Addr);
+                continue;
+            }
+            for (unsigned bit = 1; bit < 64; bit++) {
+                if ((entry >> bit) & 1) {
+                    count_reloc(&ehdr, shdrs,
+                                where + (bit - 1) * sizeof(Elf64_Addr), count,
+                                &unknown);
+                    total++;
+                }
+            }
+            where += 63 * sizeof(Elf64_Addr);
+        }
+
+        /* r_offset is the first field of both Elf64_Rel and Elf64_Rela. */
+        for (size_t j = 0; shdrs[i].sh_type != SHT_RELR &&
+                           j + shdrs[i].sh_entsize <= shdrs[i].sh_size;
+             j += shdrs[i].sh_entsize) {
+            Elf64_Addr offset;
+            memcpy(&offset, rel + j, sizeof(offset));
+            count_reloc(&ehdr, shdrs, offset, count, &unknown);
+            total++;
+        }
+
+        free(rel);
+    }
+
+    printf("%-24s %10s\n", "section", "relocs");
+    for (uint16_t i = 0; i < ehdr.e_shnum; i++) {
+        const char *name = &strtab[shdrs[i].sh_name];
+        if (count[i] || strncmp(name, "__sancov_", 9) == 0) {
+            printf("%-24s %10zu\n", name, count[i]);
+        }
+    }
+    if (unknown) {
+        printf("%-24s %10zu\n", "(outside sections)", unknown);
+    }
+    printf("%-24s %10zu\n", "total", total);
+
+    free(count);
+    free(shdrs);
+    free(strtab);
+    close(fd);
+    return 0;
+}
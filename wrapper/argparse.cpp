@@ -92,6 +92,20 @@ ArgParse::ArgParse(char **argv, char **envp) {
 #endif 
 }
 
+const char *ArgParse::sancov_def() const {
+  switch (this->coverage) {
+    case (Coverage::COUNTERS): {
+      return this->prune ? SANCOV_CNTRS_PRUNED_DEF : SANCOV_CNTRS_DEF;
+    }
+    case (Coverage::BOOLS): {
+      return this->prune ? SANCOV_BOOLS_PRUNED_DEF : SANCOV_BOOLS_DEF;
+    }
+    default: {
+      return this->prune ? SANCOV_PRUNED_DEF : SANCOV_DEFAULT_DEF;
+    }
+  }
+}
+
 void ArgParse::parse_env(void) {
   const char *eend = env_buf.buffer_end();
   const char *iter = env_buf.buffer();
@@ -101,6 +115,31 @@ void ArgParse::parse_env(void) {
       cc_name = iter + 7;
     } else if (strncmp("CFG_CXX=", iter, 8) == 0) {
       cxx_name = iter + 8;
+    } else if (strncmp("CFG_NOALLOC=", iter, 12) == 0) {
+      noalloc = strcmp(iter + 12, "1") == 0;
+    } else if (strncmp("CFG_PRUNE=", iter, 10) == 0) {
+      prune = strcmp(iter + 10, "1") == 0;
+    } else if (strncmp("CFG_EDGE_PROF=", iter, 14) == 0) {
+      edge_prof = strcmp(iter + 14, "1") == 0;
+    } else if (strncmp("CFG_PATHS=", iter, 10) == 0) {
+      paths = strcmp(iter + 10, "1") == 0;
+    } else if (strncmp("CFG_ALLOWLIST=", iter, 14) == 0) {
+      allowlist = iter + 14;
+    } else if (strncmp("CFG_DENYLIST=", iter, 13) == 0) {
+      denylist = iter + 13;
+    } else if (strncmp("CFG_UNREACHABLE=", iter, 16) == 0) {
+      unreachable = iter + 16;
+    } else if (strncmp("CFG_COVERAGE=", iter, 13) == 0) {
+      const char *mode = iter + 13;
+      if (strcmp(mode, "guard") == 0) {
+        coverage = Coverage::GUARD;
+      } else if (strcmp(mode, "counters") == 0) {
+        coverage = Coverage::COUNTERS;
+      } else if (strcmp(mode, "bools") == 0) {
+        coverage = Coverage::BOOLS;
+      } else {
+        err_message = "unknown CFG_COVERAGE, use guard, counters or bools";
+      }
     }
   }
 }
@@ -148,6 +187,18 @@ void ArgParse::parse_arg(void) {
     {
       this->opt_level = iter;
     }
+    else if (strcmp(iter, "-flto") == 0 || strcmp(iter, "-flto=full") == 0
+          || strcmp(iter, "-flto=thin") == 0)
+    {
+      /** also passed on to the compiler and the linker. */
+      this->lto = iter;
+      flags.push_back((char *)iter);
+    }
+    else if (strcmp(iter, "-fno-lto") == 0)
+    {
+      this->lto = nullptr;
+      flags.push_back((char *)iter);
+    }
     else if (strcmp(iter, "-c") == 0)
     {
       stage = Stage::OBJECT;
@@ -382,6 +433,26 @@ int ArgGenerator::assembler(const char *input, const char *output, bool llvm) co
   return exe.run();
 }
 
+int ArgGenerator::lto_object(const char *input, const char *output) const
+{
+  struct ArgList alst;
+
+  /** the IR is already optimized, and thin LTO needs the flag to write the
+   * summary. */
+  alst.push(parser.cc_name);
+  alst.push(parser.lto);
+  alst.push("-c");
+  alst.push(input);
+  alst.push("-o");
+  alst.push(output);
+  alst.push(nullptr);
+
+  Exec exe;
+  exe.argv = alst.buf;
+  exe.envp = elst.buf;
+  return exe.run();
+}
+
 int ArgGenerator::linker(const std::vector<const char *> &inputs, const char *output) const {
   struct ArgList alst;
 
@@ -551,9 +622,10 @@ int ArgGenerator::execute() const {
     }
 
 
-    /** run pass plugin on the ll assembly. */
+    /** run pass plugin on the ll assembly, or once at link time with full
+     * LTO. */
     const auto &passes = this->extra_pass_names;
-    const size_t npass = passes.size();
+    const size_t npass = parser.full_lto() ? 0 : passes.size();
     TempPool tpool;
     tpool.envp = this->elst.buf;
     ofile = (npass == 0) ? output : tpool.next(
@@ -589,6 +661,35 @@ int ArgGenerator::execute() const {
     return 0;
   }
 
+  /** ll_assembly -> bitcode object, code is generated at link time. */
+  if (parser.lto != nullptr && parser.stage != ArgParse::Stage::ASSEMBLY) {
+    ctmp = !(parser.stage == ArgParse::Stage::OBJECT);
+    while (!ll_assembly.empty()) {
+      const auto obj = ll_assembly.top();
+      const char *input = obj.first;
+      ll_assembly.pop();
+
+      const char *output;
+      if (parser.input_files.size() == 1
+       && parser.stage == ArgParse::Stage::OBJECT
+       && parser.output_file != nullptr) {
+        output = parser.output_file;
+      } else if (ctmp) {
+        output = tempfiles.next(CFG_MKTEMP_TEMPLATE ".o");
+      } else {
+        tbuf.clear();
+        tbuf.replace_suffix(obj.second, ".o");
+        output = tbuf.buffer();
+      }
+
+      if (this->lto_object(input, output) != 0) {
+        fprintf(stderr, ERROR_PREFIX "failed to write bitcode object\n");
+        return 1;
+      }
+      object.push({output, obj.second});
+    }
+  }
+
   /** ll_assembly -> assembly */
   ctmp = !(parser.stage == ArgParse::Stage::ASSEMBLY);
   while (!ll_assembly.empty()) {
@@ -8,6 +8,13 @@ class ArgParse {
     CXX
   };
 
+  /** what sancov inserts in each block, see CFG_COVERAGE. */
+  enum class Coverage {
+    GUARD = 0, // trace-pc-guard, a callback
+    COUNTERS, // inline-8bit-counters, __sancov_cntrs
+    BOOLS, // inline-bool-flag, __sancov_bools
+  };
+
   enum class Stage {
     LINK = 0, // ??
     PREPROCESS, // -E, execute preprocessor
@@ -43,18 +50,33 @@ class ArgParse {
   }
 
   const char *output_suffix() const;
+  /** -fsanitize-coverage= flag for the coverage mode, pruned or not. */
+  const char *sancov_def() const;
   static const char *suffix_of(const char *path);
   bool runpass() const {
     return this->stage == Stage::ASSEMBLY || this->stage == Stage::OBJECT;
   }
+  /** -flto or -flto=full: the passes run once at link time, in lld. */
+  bool full_lto() const {
+    return this->lto != nullptr && strcmp(this->lto, "-flto=thin") != 0;
+  }
 
  // private:
   /** NOTE: these fields are immutable. Modify them at your own risk. */
   const char *cc_name{nullptr}; // [env] CFG_CC=
   const char *cxx_name{nullptr}; // [env] CFG_CXX=
+  bool noalloc{false}; // [env] CFG_NOALLOC=1, link cfg sections as non-alloc
+  bool prune{false}; // [env] CFG_PRUNE=1, let sancov prune dominated blocks
+  bool edge_prof{false}; // [env] CFG_EDGE_PROF=1, count edges, link cfgprof
+  bool paths{false}; // [env] CFG_PATHS=1, count paths, link cfgprof
+  const char *allowlist{nullptr}; // [env] CFG_ALLOWLIST=, only instrument these
+  const char *denylist{nullptr}; // [env] CFG_DENYLIST=, do not instrument these
+  const char *unreachable{nullptr}; // [env] CFG_UNREACHABLE=, cfgdump -u output
+  enum Coverage coverage{Coverage::GUARD}; // [env] CFG_COVERAGE=guard|counters|bools
 
   const char *debug{nullptr}; // -g, -gdwarf-4, etc.
   const char *opt_level{nullptr}; // -O2, -O3, ..
+  const char *lto{nullptr}; // -flto, -flto=full, -flto=thin, objects are bitcode
   const char *output_file{nullptr}; // -o a.out
   const char *lang{nullptr}; /* c, c++ */
   enum Lang link_lang{Lang::C};
@@ -139,6 +161,8 @@ class ArgGenerator {
   int preprocessor(const char *input, const char *output) const;
   int compiler(const char *input, const char *output, bool llvm) const;
   int assembler(const char *input, const char *output, bool llvm) const;
+  /** .ll => bitcode object for the LTO link. */
+  int lto_object(const char *input, const char *output) const;
   int llvm_as(const char *input, const char *output) const {
     const char *suffix = ArgParse::suffix_of(input);
     assert(strcmp(suffix, ".ll") == 0 && "not an .ll file");
@@ -31,10 +31,41 @@
 #define CFG_MKTEMP_TEMPLATE "/tmp/tmp.XXXXXXXXXX"
 #endif
 
+#ifndef SANCOV_ALLOWLIST_DEF
+#define SANCOV_ALLOWLIST_DEF "-fsanitize-coverage-allowlist="
+#endif // SANCOV_ALLOWLIST_DEF
+
+#ifndef SANCOV_DENYLIST_DEF
+#define SANCOV_DENYLIST_DEF "-fsanitize-coverage-ignorelist="
+#endif // SANCOV_DENYLIST_DEF
+
 #ifndef SANCOV_DEFAULT_DEF
 #define SANCOV_DEFAULT_DEF "-fsanitize-coverage=trace-pc-guard,pc-table,no-prune"
 #endif // SANCOV_DEFAULT_DEF
 
+#ifndef SANCOV_PRUNED_DEF
+#define SANCOV_PRUNED_DEF "-fsanitize-coverage=trace-pc-guard,pc-table"
+#endif // SANCOV_PRUNED_DEF
+
+#ifndef SANCOV_CNTRS_DEF
+#define SANCOV_CNTRS_DEF "-fsanitize-coverage=inline-8bit-counters,pc-table,no-prune"
+#endif // SANCOV_CNTRS_DEF
+
+#ifndef SANCOV_CNTRS_PRUNED_DEF
+#define SANCOV_CNTRS_PRUNED_DEF "-fsanitize-coverage=inline-8bit-counters,pc-table"
+#endif // SANCOV_CNTRS_PRUNED_DEF
+
+#ifndef SANCOV_BOOLS_DEF
+#define SANCOV_BOOLS_DEF "-fsanitize-coverage=inline-bool-flag,pc-table,no-prune"
+#endif // SANCOV_BOOLS_DEF
+
+#ifndef SANCOV_BOOLS_PRUNED_DEF
+#define SANCOV_BOOLS_PRUNED_DEF "-fsanitize-coverage=inline-bool-flag,pc-table"
+#endif // SANCOV_BOOLS_PRUNED_DEF
+
+#ifndef CFG_ALL_PASS
+#error "CFG_ALL_PASS is not defined"
+#endif
 #ifndef CFG_EDGE_PASS
 #error "CFG_EDGE_PASS is not defined"
 #endif
@@ -44,6 +75,12 @@
 #ifndef FUNC_ENTRY_PASS
 #error "FUNC_ENTRY_PASS is not defined"
 #endif
+#ifndef CFG_NOALLOC_SCRIPT
+#error "CFG_NOALLOC_SCRIPT is not defined"
+#endif
+#ifndef CFG_PROF_LIB
+#error "CFG_PROF_LIB is not defined"
+#endif
 
 
 typedef const char *ccharptr_t;
@@ -12,11 +12,43 @@ extern "C" int main(int argc, char **argv, char **envp) {
   }
 
   ArgGenerator exe(parser);
-  exe.add_pass_plugin("-fpass-plugin=" CFG_EDGE_PASS)
-     .add_pass_plugin("-fpass-plugin=" FUNC_CALL_PASS)
-     .add_pass_plugin("-fpass-plugin=" FUNC_ENTRY_PASS)
-     .add_compile_arg(SANCOV_DEFAULT_DEF)
-     .add_link_arg(SANCOV_DEFAULT_DEF);
+  /** pruned blocks are recovered from __sancov_blocks, see cfgdump -b. */
+  const char *sancov = parser.sancov_def();
+  /** cfg-all = cfg-edge + func-call + func-entry, in a single run. */
+  exe.add_pass_plugin("-fpass-plugin=" CFG_ALL_PASS)
+     .add_compile_arg(sancov)
+     .add_link_arg(sancov);
+  /** sancov and the passes (which read the same variables) leave out the
+   * same code, see common/CoverageFilter.h. */
+  std::string allowlist, denylist, unreachable;
+  if (parser.allowlist && *parser.allowlist) {
+    allowlist = std::string(SANCOV_ALLOWLIST_DEF) + parser.allowlist;
+    exe.add_compile_arg(allowlist.c_str());
+  }
+  if (parser.denylist && *parser.denylist) {
+    denylist = std::string(SANCOV_DENYLIST_DEF) + parser.denylist;
+    exe.add_compile_arg(denylist.c_str());
+  }
+  /** functions cfgdump -u found unreachable in a previous build. */
+  if (parser.unreachable && *parser.unreachable) {
+    unreachable = std::string(SANCOV_DENYLIST_DEF) + parser.unreachable;
+    exe.add_compile_arg(unreachable.c_str());
+  }
+  /** keep the cfg sections in the file only, see cfg-noalloc.ld. */
+  if (parser.noalloc)
+    exe.add_link_arg("-Wl,-T," CFG_NOALLOC_SCRIPT);
+  /** LTO needs lld, full LTO runs cfg-all there once over the whole
+   * program instead of per translation unit. */
+  if (parser.lto) {
+    exe.add_link_arg("-fuse-ld=lld");
+    if (parser.opt_level)
+      exe.add_link_arg(parser.opt_level);
+    if (parser.full_lto())
+      exe.add_link_arg("-Wl,--load-pass-plugin=" CFG_ALL_PASS);
+  }
+  /** dumps the edge and path counters at exit, see cfgdump -p and -P. */
+  if (parser.edge_prof || parser.paths)
+    exe.add_link_arg(CFG_PROF_LIB);
     
   return exe.execute();
 }
@@ -0,0 +1,70 @@
+/** Runtime of the edge and path profiles (CFG_EDGE_PROF=1, CFG_PATHS=1):
+ * each module constructor hands the bounds of its counters to
+ * __cfg_eprof_init or __cfg_paths_init, and the counters are written at exit,
+ * raw, to $CFG_EPROF_OUT (cfg.eprof by default) for cfgdump -p and to
+ * $CFG_PATHS_OUT (cfg.paths) for cfgdump -P. One linked object per process
+ * is profiled. */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct cfg_counters {
+  uint64_t *start;
+  uint64_t *stop;
+  const char *env;
+  const char *path;
+};
+
+static struct cfg_counters eprof = {NULL, NULL, "CFG_EPROF_OUT", "cfg.eprof"};
+static struct cfg_counters paths = {NULL, NULL, "CFG_PATHS_OUT", "cfg.paths"};
+
+static void cfg_counters_dump(const struct cfg_counters *counters)
+{
+  if (!counters->start) {
+    return;
+  }
+  const char *path = getenv(counters->env);
+  FILE *file = fopen(path ? path : counters->path, "wb");
+  if (!file) {
+    perror(counters->path);
+    return;
+  }
+  fwrite(counters->start, sizeof(uint64_t),
+         counters->stop - counters->start, file);
+  fclose(file);
+}
+
+static void cfg_eprof_dump(void)
+{
+  cfg_counters_dump(&eprof);
+}
+
+static void cfg_paths_dump(void)
+{
+  cfg_counters_dump(&paths);
+}
+
+static int cfg_counters_init(struct cfg_counters *counters, uint64_t *start,
+                             uint64_t *stop)
+{
+  if (start == stop || counters->start) {
+    return 0;
+  }
+  counters->start = start;
+  counters->stop = stop;
+  return 1;
+}
+
+void __cfg_eprof_init(uint64_t *start, uint64_t *stop)
+{
+  if (cfg_counters_init(&eprof, start, stop)) {
+    atexit(cfg_eprof_dump);
+  }
+}
+
+void __cfg_paths_init(uint64_t *start, uint64_t *stop)
+{
+  if (cfg_counters_init(&paths, start, stop)) {
+    atexit(cfg_paths_dump);
+  }
+}